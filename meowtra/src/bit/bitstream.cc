@@ -173,10 +173,11 @@ uint32_t get_next_frame(const std::vector<FrameRange> &ranges, uint32_t slr, uin
 }
 }
 
-BitstreamFrames packets_to_frames(const std::vector<BitstreamPacket> &packets) {
+BitstreamFrames packets_to_frames(Context *ctx, const std::vector<BitstreamPacket> &packets) {
     BitstreamFrames res;
     uint32_t far = 0;
-    std::vector<FrameRange> frame_ranges;
+    static const std::vector<FrameRange> no_ranges;
+    const std::vector<FrameRange> *frame_ranges = &no_ranges;
 
     const int frame_length = 93; // TODO: other devices than xcup
     int null_frame_count = 0;
@@ -187,12 +188,12 @@ BitstreamFrames packets_to_frames(const std::vector<BitstreamPacket> &packets) {
             res.dev = device_by_idcode(idc);
             if (!res.dev)
                 log_error("no known device with IDCODE 0x%08x\n", idc);
-            frame_ranges = get_device_frames(*res.dev);
+            frame_ranges = &get_device_db(ctx, *res.dev).frame_ranges;
         } else if (packet.reg == BitstreamPacket::FAR && packet.payload.size() >= 1) {
             far = packet.payload.get(0);
         } else if (packet.reg == BitstreamPacket::CRC) {
             // increment FAR
-            far = get_next_frame(frame_ranges, packet.slr, far);
+            far = get_next_frame(*frame_ranges, packet.slr, far);
         } else if (packet.reg == BitstreamPacket::FDRI) {
             // TODO: check ECC etc
             // TODO: split frames?
@@ -207,7 +208,7 @@ BitstreamFrames packets_to_frames(const std::vector<BitstreamPacket> &packets) {
                     --null_frame_count;
                 } else {
                     res.frame_data.emplace(FrameKey{packet.slr, far}, packet.payload.subchunk(i, std::min(frame_length, packet.payload.size() - i)));
-                    auto next_far = get_next_frame(frame_ranges, packet.slr, far);
+                    auto next_far = get_next_frame(*frame_ranges, packet.slr, far);
                     if ((far ^ next_far) >> 18U && packet.payload.size() != frame_length) {
                         // end of a row
                         null_frame_count = 2;
@@ -54,6 +54,7 @@ struct BitstreamPacket {
 };
 
 struct Device;
+struct Context;
 
 struct FrameKey {
     uint32_t slr;
@@ -68,7 +69,7 @@ struct BitstreamFrames {
     dict<FrameKey, Chunk<uint32_t>> frame_data; 
 };
 
-BitstreamFrames packets_to_frames(const std::vector<BitstreamPacket> &packets);
+BitstreamFrames packets_to_frames(Context *ctx, const std::vector<BitstreamPacket> &packets);
 
 MEOW_NAMESPACE_END
 
@@ -0,0 +1,106 @@
+#include "decoder.h"
+#include "database.h"
+#include "log.h"
+
+#include <algorithm>
+
+MEOW_NAMESPACE_BEGIN
+
+void FeatureDecoder::compile(Context *ctx, const SegBits &segbits, const DeviceDatabase &db) {
+    this->db = &db;
+    dict<IdString, const TileRegion *> tile_type_regions;
+    for (auto &r : db.tile_regions)
+        tile_type_regions[r.prefix] = &r;
+    for (auto &tt : segbits.tile_types) {
+        auto found = tile_type_regions.find(tt.first);
+        if (found == tile_type_regions.end())
+            continue; // not a tile type on this device (e.g. a site type)
+        auto &r = *found->second;
+        index_t frame_bits = r.tile_height * 48;
+        auto &table = tables[tt.first];
+        table.size = r.tile_frames * frame_bits;
+        table.features.clear();
+        table.offsets.clear();
+        table.words.clear();
+        std::vector<MaskWord> feat_words;
+        for (auto &entry : tt.second) {
+            if (entry.bits.empty())
+                continue; // can't be detected from the bitstream
+            feat_words.clear();
+            bool valid = true;
+            for (auto &b : entry.bits) {
+                index_t bit = b.frame * frame_bits + b.bit;
+                if (b.bit >= frame_bits || bit >= table.size) {
+                    valid = false;
+                    break;
+                }
+                index_t word = bit / 64;
+                auto found_word = std::find_if(feat_words.begin(), feat_words.end(), [&](const MaskWord &w) { return w.word == word; });
+                if (found_word == feat_words.end()) {
+                    feat_words.push_back(MaskWord{word, 0, 0});
+                    found_word = feat_words.end() - 1;
+                }
+                found_word->mask |= (uint64_t(1) << (bit % 64));
+                if (!b.inverted)
+                    found_word->compare |= (uint64_t(1) << (bit % 64));
+            }
+            if (!valid) {
+                log_warning("feature bits out of range for tile type %s\n", tt.first.c_str(ctx));
+                continue;
+            }
+            table.features.push_back(entry.feature);
+            table.offsets.push_back(index_t(table.words.size()));
+            table.words.insert(table.words.end(), feat_words.begin(), feat_words.end());
+        }
+        table.offsets.push_back(index_t(table.words.size()));
+    }
+}
+
+void FeatureDecoder::decode(const TileData &tile, pool<Feature> &result) const {
+    auto found = tables.find(tile.tile_type);
+    if (found == tables.end())
+        return;
+    auto &table = found->second;
+    MEOW_ASSERT(table.size == tile.set_bits.size());
+    const uint64_t *tile_words = tile.set_bits.words.data();
+    for (index_t i = 0; i < index_t(table.features.size()); i++) {
+        bool match = true;
+        for (index_t j = table.offsets.at(i); j < table.offsets.at(i + 1); j++) {
+            auto &w = table.words[j];
+            if ((tile_words[w.word] & w.mask) != w.compare) {
+                match = false;
+                break;
+            }
+        }
+        if (match)
+            result.insert(table.features.at(i));
+    }
+}
+
+TileFeatures FeatureDecoder::decode(const TileGrid &grid) const {
+    MEOW_ASSERT(db);
+    TileFeatures result;
+    for (auto &tile : grid.tiles) {
+        pool<Feature> features;
+        decode(tile.second, features);
+        if (!features.empty())
+            result.tiles[tile.first] = std::move(features);
+    }
+    // features that hold in the default bits (e.g. inverted ones) also hold in every tile left at the default
+    dict<IdString, pool<Feature>> default_features;
+    for (auto &tile : grid.defaults)
+        decode(tile.second, default_features[tile.first]);
+    for (auto &r : db->tile_regions) {
+        auto found = default_features.find(r.prefix);
+        if (found == default_features.end() || found->second.empty())
+            continue;
+        for (index_t i = 0; i < r.num_tiles; i++) {
+            TileKey key = r.tile_key(i);
+            if (!grid.tiles.count(key))
+                result.tiles[key] = found->second;
+        }
+    }
+    return result;
+}
+
+MEOW_NAMESPACE_END
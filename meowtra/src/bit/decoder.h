@@ -0,0 +1,41 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include "preface.h"
+#include "hashlib.h"
+#include "feature.h"
+#include "segbits.h"
+#include "tile.h"
+
+#include <vector>
+
+MEOW_NAMESPACE_BEGIN
+
+struct Context;
+struct DeviceDatabase;
+
+// Turns decoded tile bits back into features, using segbits compiled into per-tile-type mask/compare tables
+struct FeatureDecoder {
+    struct MaskWord {
+        index_t word;
+        uint64_t mask, compare; // feature matches if (tile_word & mask) == compare
+    };
+    struct TileTypeTable {
+        index_t size = 0; // tile bits
+        std::vector<Feature> features;
+        std::vector<index_t> offsets; // features.size() + 1 offsets into words
+        std::vector<MaskWord> words;
+    };
+    dict<IdString, TileTypeTable> tables;
+    const DeviceDatabase *db = nullptr; // set by compile
+
+    void compile(Context *ctx, const SegBits &segbits, const DeviceDatabase &db);
+    void decode(const TileData &tile, pool<Feature> &result) const;
+    // decodes every tile of the device; tiles the grid dropped as default get the features of their tile type
+    // default, which are only decoded once per tile type
+    TileFeatures decode(const TileGrid &grid) const;
+};
+
+MEOW_NAMESPACE_END
+
+#endif
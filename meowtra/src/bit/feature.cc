@@ -1,5 +1,6 @@
 #include "feature.h"
 #include "context.h"
+#include "tile_filter.h"
 
 MEOW_NAMESPACE_BEGIN
 
@@ -20,14 +21,17 @@ void Feature::write(Context *ctx, std::ostream &out) const {
         out << '[' << bit << ']';
 }
 
-TileFeatures TileFeatures::parse(Context *ctx, line_range lines) {
+TileFeatures TileFeatures::parse(Context *ctx, line_range lines, const TileTypeFilter *filter) {
     TileFeatures result;
     for (auto line : lines) {
         auto i = line.begin();
         if (i == line.end())
             continue;
         auto [tile, feature] = split_view(*i, '.');
-        result.tiles[TileKey::parse(ctx, tile)].insert(Feature::parse(ctx, feature));
+        auto key = TileKey::parse(ctx, tile);
+        if (filter && !filter->match(ctx, key.prefix))
+            continue;
+        result.tiles[key].insert(Feature::parse(ctx, feature));
     }
     return result;
 }
@@ -27,9 +27,12 @@ struct Feature {
     void write(Context *ctx, std::ostream &out) const;
 };
 
+struct TileTypeFilter;
+
 struct TileFeatures {
     dict<TileKey, pool<Feature>> tiles;
-    static TileFeatures parse(Context *ctx, line_range lines);
+    // tiles of types not selected by filter (if given) are skipped
+    static TileFeatures parse(Context *ctx, line_range lines, const TileTypeFilter *filter = nullptr);
     void write(Context *ctx, std::ostream &out) const;
 };
 
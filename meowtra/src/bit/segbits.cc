@@ -0,0 +1,331 @@
+#include "segbits.h"
+#include "context.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+MEOW_NAMESPACE_BEGIN
+
+namespace {
+
+const uint64_t segbits_magic = 0x32474553574f454dULL; // "MEOWSEG2"
+
+// picks up 'deps: N', 'count: M' and 'conf: x.xx...' (one per bit, in the order given) from a result comment
+void parse_metadata(std::string_view comment, SegBitsEntry &entry) {
+    auto get_field = [&](std::string_view name) -> index_t {
+        auto pos = comment.find(name);
+        if (pos == std::string_view::npos)
+            return -1;
+        return parse_i32(comment.substr(pos + name.size()));
+    };
+    entry.deps = get_field("deps: ");
+    entry.count = get_field("count: ");
+    auto pos = comment.find("conf:");
+    if (pos == std::string_view::npos)
+        return;
+    std::string_view rest = comment.substr(pos + 5);
+    rest = rest.substr(0, rest.find(','));
+    for (auto &b : entry.bits) {
+        size_t start = rest.find_first_not_of(' ');
+        if (start == std::string_view::npos)
+            break;
+        rest = rest.substr(start);
+        b.conf = std::strtof(std::string(rest.substr(0, rest.find(' '))).c_str(), nullptr);
+        rest = rest.substr(std::min(rest.size(), rest.find(' ')));
+    }
+}
+
+// (name, size, mtime) of each text file in a database, to tell whether segbits.bin is still up to date
+struct TextFileKey {
+    std::string name;
+    uint64_t size, mtime;
+    bool operator<(const TextFileKey &other) const { return name < other.name; }
+    bool operator==(const TextFileKey &other) const {
+        return name == other.name && size == other.size && mtime == other.mtime;
+    }
+};
+
+std::vector<TextFileKey> text_file_keys(const std::filesystem::path &db_dir) {
+    std::vector<TextFileKey> result;
+    for (auto &entry : std::filesystem::directory_iterator(db_dir)) {
+        auto name = entry.path().filename().string();
+        if (name.rfind("segbits_", 0) != 0 || entry.path().extension() != ".txt")
+            continue;
+        result.push_back(TextFileKey{name, uint64_t(std::filesystem::file_size(entry.path())),
+                uint64_t(std::filesystem::last_write_time(entry.path()).time_since_epoch().count())});
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::string_view line_comment(const std::string &buf, index_t start) {
+    auto end = buf.find_first_of("\r\n", start);
+    std::string_view line(buf.data() + start, (end == std::string::npos ? buf.size() : end) - start);
+    auto pos = line.find('#');
+    return (pos == std::string_view::npos) ? std::string_view() : line.substr(pos + 1);
+}
+
+struct BinWriter {
+    std::vector<char> buf;
+    template <typename T> void put(T value) {
+        const char *p = reinterpret_cast<const char*>(&value);
+        buf.insert(buf.end(), p, p + sizeof(T));
+    }
+};
+
+struct BinReader {
+    const char *ptr, *end;
+    template <typename T> T get() {
+        T value{};
+        if (end - ptr < index_t(sizeof(T)))
+            log_error("unexpected end of segbits.bin\n");
+        memcpy(&value, ptr, sizeof(T));
+        ptr += sizeof(T);
+        return value;
+    }
+};
+
+std::vector<IdString> sorted_tile_types(Context *ctx, const SegBits &segbits) {
+    std::vector<IdString> result;
+    for (auto &tt : segbits.tile_types)
+        result.push_back(tt.first);
+    std::sort(result.begin(), result.end(), [&](IdString a, IdString b) { return a.str(ctx) < b.str(ctx); });
+    return result;
+}
+
+}
+
+void SegBits::parse(Context *ctx, line_range lines) {
+    std::vector<SegBitsEntry> *curr = nullptr;
+    for (auto line : lines) {
+        auto i = line.begin();
+        if (i == line.end())
+            continue;
+        if (*i == "***") {
+            ++i;
+            MEOW_ASSERT(i != line.end());
+            curr = &tile_types[ctx->id(std::string(*i))];
+            continue;
+        }
+        if (!curr)
+            log_error("segbits entry '%s' before any tile type header\n", std::string(*i).c_str());
+        curr->emplace_back(Feature::parse(ctx, *i++));
+        auto &entry = curr->back();
+        for (; i != line.end(); ++i) {
+            auto word = *i;
+            SegBit b;
+            b.inverted = (word.at(0) == '!');
+            auto [frame, bit] = split_view(b.inverted ? word.substr(1) : word, '_');
+            b.frame = parse_i32(frame);
+            b.bit = parse_i32(bit);
+            entry.bits.push_back(b);
+        }
+        parse_metadata(line_comment(line.buf, line.start), entry);
+    }
+}
+
+void SegBits::merge(Context *ctx, const SegBits &other) {
+    for (auto &tt : other.tile_types) {
+        auto &entries = tile_types[tt.first];
+        dict<Feature, index_t> existing;
+        for (index_t i = 0; i < index_t(entries.size()); i++)
+            existing[entries.at(i).feature] = i;
+        for (auto &entry : tt.second) {
+            auto found = existing.find(entry.feature);
+            if (found == existing.end()) {
+                existing[entry.feature] = index_t(entries.size());
+                entries.push_back(entry);
+                continue;
+            }
+            auto &curr = entries.at(found->second);
+            bool same_bits = curr.bits.size() == entry.bits.size() &&
+                std::is_permutation(curr.bits.begin(), curr.bits.end(), entry.bits.begin(), [](const SegBit &a, const SegBit &b) {
+                    return a.frame == b.frame && a.bit == b.bit && a.inverted == b.inverted;
+                });
+            if (!same_bits) {
+                std::ostringstream feat;
+                entry.feature.write(ctx, feat);
+                log_verbose("conflicting results for %s.%s, keeping the one with the higher count\n",
+                    tt.first.c_str(ctx), feat.str().c_str());
+            }
+            if (entry.count > curr.count)
+                curr = entry;
+        }
+    }
+}
+
+void SegBits::write(Context *ctx, IdString tile_type, std::ostream &out) const {
+    std::vector<SegBitsEntry> entries = tile_types.at(tile_type);
+    std::sort(entries.begin(), entries.end(), [&](const SegBitsEntry &a, const SegBitsEntry &b) {
+        const auto &sa = a.feature.base.str(ctx), &sb = b.feature.base.str(ctx);
+        return (sa < sb) || ((sa == sb) && a.feature.bit < b.feature.bit);
+    });
+    out << "*** " << tile_type.str(ctx) << " ***" << std::endl;
+    for (auto &entry : entries) {
+        auto bits = entry.bits;
+        std::sort(bits.begin(), bits.end(), [](const SegBit &a, const SegBit &b) {
+            return (a.frame < b.frame) || ((a.frame == b.frame) && a.bit < b.bit);
+        });
+        entry.feature.write(ctx, out);
+        for (auto &b : bits)
+            out << " " << (b.inverted ? "!" : "") << b.frame << "_" << b.bit;
+        if (entry.deps != -1 || entry.count != -1)
+            out << " # deps: " << entry.deps << ", count: " << entry.count;
+        if (!bits.empty() && std::all_of(bits.begin(), bits.end(), [](const SegBit &b) { return b.conf >= 0; })) {
+            out << ", conf:";
+            for (auto &b : bits)
+                out << stringf(" %.2f", b.conf);
+        }
+        out << std::endl;
+    }
+}
+
+void SegBits::write_db(Context *ctx, const std::string &dir) const {
+    std::filesystem::path db_dir(dir);
+    std::filesystem::create_directories(db_dir);
+    auto tile_type_order = sorted_tile_types(ctx, *this);
+    for (auto tt : tile_type_order) {
+        std::ofstream out(db_dir / ("segbits_" + tt.str(ctx) + ".txt"));
+        if (!out)
+            log_error("failed to write segbits for %s in '%s'\n", tt.c_str(ctx), dir.c_str());
+        write(ctx, tt, out);
+    }
+    // binary form: header, string table, then an index of (tile type, entry count, offset) followed by the entries
+    BinWriter body, index;
+    idict<IdString> strings;
+    for (auto tt : tile_type_order) {
+        auto &entries = tile_types.at(tt);
+        index.put<uint32_t>(strings(tt));
+        index.put<uint32_t>(entries.size());
+        index.put<uint64_t>(body.buf.size());
+        for (auto &entry : entries) {
+            body.put<uint32_t>(strings(entry.feature.base));
+            body.put<int32_t>(entry.feature.bit);
+            body.put<int32_t>(entry.deps);
+            body.put<int32_t>(entry.count);
+            body.put<uint32_t>(entry.bits.size());
+            for (auto &b : entry.bits) {
+                body.put<int32_t>(b.frame);
+                body.put<int32_t>(b.bit);
+                body.put<uint8_t>(b.inverted);
+                body.put<float>(b.conf);
+            }
+        }
+    }
+    BinWriter header;
+    header.put<uint64_t>(segbits_magic);
+    // the text files just written; the binary form is stale as soon as any of these change or others appear
+    auto keys = text_file_keys(db_dir);
+    header.put<uint32_t>(keys.size());
+    for (auto &key : keys) {
+        header.put<uint32_t>(key.name.size());
+        header.buf.insert(header.buf.end(), key.name.begin(), key.name.end());
+        header.put<uint64_t>(key.size);
+        header.put<uint64_t>(key.mtime);
+    }
+    header.put<uint32_t>(strings.size());
+    for (auto id : strings) {
+        const std::string &str = id.str(ctx);
+        header.put<uint32_t>(str.size());
+        header.buf.insert(header.buf.end(), str.begin(), str.end());
+    }
+    header.put<uint32_t>(tile_type_order.size());
+    std::ofstream out(db_dir / "segbits.bin", std::ios::binary);
+    if (!out)
+        log_error("failed to write '%s/segbits.bin'\n", dir.c_str());
+    out.write(header.buf.data(), header.buf.size());
+    out.write(index.buf.data(), index.buf.size());
+    out.write(body.buf.data(), body.buf.size());
+}
+
+void SegBits::read_db(Context *ctx, const std::string &dir) {
+    std::filesystem::path db_dir(dir), bin_path = db_dir / "segbits.bin";
+    auto keys = text_file_keys(db_dir);
+    std::vector<char> buf;
+    if (std::filesystem::exists(bin_path)) {
+        std::ifstream in(bin_path, std::ios::binary);
+        buf.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    BinReader rd{buf.data(), buf.data() + buf.size()};
+    // the binary form is only used if it was written with exactly the text files that are there now
+    bool use_bin = buf.size() >= sizeof(uint64_t) && rd.get<uint64_t>() == segbits_magic;
+    if (use_bin) {
+        std::vector<TextFileKey> bin_keys(rd.get<uint32_t>());
+        for (auto &key : bin_keys) {
+            uint32_t len = rd.get<uint32_t>();
+            if (rd.end - rd.ptr < index_t(len))
+                log_error("unexpected end of segbits.bin\n");
+            key.name = std::string(rd.ptr, len);
+            rd.ptr += len;
+            key.size = rd.get<uint64_t>();
+            key.mtime = rd.get<uint64_t>();
+        }
+        use_bin = (bin_keys == keys);
+    }
+    if (!use_bin) {
+        log_verbose("segbits.bin in '%s' is missing or out of date, reading text files\n", dir.c_str());
+        for (auto &key : keys) {
+            std::ifstream in(db_dir / key.name);
+            std::string text(std::istreambuf_iterator<char>(in), {});
+            SegBits file_segbits;
+            file_segbits.parse(ctx, lines(text));
+            merge(ctx, file_segbits);
+        }
+        return;
+    }
+    std::vector<IdString> strings(rd.get<uint32_t>());
+    for (auto &id : strings) {
+        uint32_t len = rd.get<uint32_t>();
+        if (rd.end - rd.ptr < index_t(len))
+            log_error("unexpected end of segbits.bin\n");
+        id = ctx->id(std::string(rd.ptr, len));
+        rd.ptr += len;
+    }
+    uint32_t num_tile_types = rd.get<uint32_t>();
+    const char *body = rd.ptr + num_tile_types * (2 * sizeof(uint32_t) + sizeof(uint64_t));
+    SegBits file_segbits;
+    for (uint32_t i = 0; i < num_tile_types; i++) {
+        IdString tt = strings.at(rd.get<uint32_t>());
+        uint32_t num_entries = rd.get<uint32_t>();
+        uint64_t offset = rd.get<uint64_t>();
+        if (offset > uint64_t(rd.end - body))
+            log_error("corrupt index in segbits.bin\n");
+        BinReader entry_rd{body + offset, rd.end};
+        auto &entries = file_segbits.tile_types[tt];
+        for (uint32_t j = 0; j < num_entries; j++) {
+            IdString base = strings.at(entry_rd.get<uint32_t>());
+            entries.emplace_back(Feature(base, entry_rd.get<int32_t>()));
+            auto &entry = entries.back();
+            entry.deps = entry_rd.get<int32_t>();
+            entry.count = entry_rd.get<int32_t>();
+            entry.bits.resize(entry_rd.get<uint32_t>());
+            for (auto &b : entry.bits) {
+                b.frame = entry_rd.get<int32_t>();
+                b.bit = entry_rd.get<int32_t>();
+                b.inverted = entry_rd.get<uint8_t>();
+                b.conf = entry_rd.get<float>();
+            }
+        }
+    }
+    merge(ctx, file_segbits);
+}
+
+void SegBits::load(Context *ctx, const std::string &path) {
+    if (std::filesystem::is_directory(path)) {
+        read_db(ctx, path);
+        return;
+    }
+    std::ifstream in(path);
+    if (!in)
+        log_error("failed to open '%s'\n", path.c_str());
+    std::string buf(std::istreambuf_iterator<char>(in), {});
+    SegBits file_segbits;
+    file_segbits.parse(ctx, lines(buf));
+    merge(ctx, file_segbits);
+}
+
+MEOW_NAMESPACE_END
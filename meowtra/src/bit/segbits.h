@@ -0,0 +1,55 @@
+#ifndef SEGBITS_H
+#define SEGBITS_H
+
+#include "preface.h"
+#include "idstring.h"
+#include "hashlib.h"
+#include "feature.h"
+#include "datafile.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+MEOW_NAMESPACE_BEGIN
+
+struct Context;
+
+// One bit of a feature, in frame/bit-within-frame tile coordinates
+struct SegBit {
+    index_t frame;
+    index_t bit;
+    bool inverted = false; // feature requires the bit to be clear
+    float conf = -1; // from the correlate comment ('conf: x.xx' per bit), -1 if unknown
+};
+
+struct SegBitsEntry {
+    explicit SegBitsEntry(Feature feature) : feature(feature) {};
+    Feature feature;
+    std::vector<SegBit> bits;
+    // metadata from the correlate comment ('# deps: N, count: M'), -1 if unknown
+    index_t deps = -1, count = -1;
+};
+
+// Feature -> bits results for a set of tile types, as written by correlate
+struct SegBits {
+    dict<IdString, std::vector<SegBitsEntry>> tile_types;
+    // parses correlate output: '*** TILE_TYPE ***' headers followed by 'FEATURE frame_bit...' lines
+    void parse(Context *ctx, line_range lines);
+    // merges in other results; where both have a feature, the one seen in more specimens wins
+    void merge(Context *ctx, const SegBits &other);
+    // writes one tile type in the correlate output format, with entries and bits sorted
+    void write(Context *ctx, IdString tile_type, std::ostream &out) const;
+
+    // A result database is a directory with a segbits_<TILE_TYPE>.txt per tile type, which are the source of truth
+    // and easy to diff, plus segbits.bin, an indexed binary form of all of them that is faster to load. The binary
+    // form records the size and mtime of the text files it was written with, and is only used while those match.
+    void read_db(Context *ctx, const std::string &dir);
+    void write_db(Context *ctx, const std::string &dir) const;
+    // loads either a database directory or a single correlate output file
+    void load(Context *ctx, const std::string &path);
+};
+
+MEOW_NAMESPACE_END
+
+#endif
@@ -0,0 +1,239 @@
+#include "spec_cache.h"
+#include "context.h"
+#include "database.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+
+#if !defined(_WIN32)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+MEOW_NAMESPACE_BEGIN
+
+namespace {
+
+const uint64_t cache_magic = 0x3248434143574f4dULL; // "MOWCACH2"
+
+// size and mtime of both inputs; the cache is only valid if all of these match
+std::vector<uint64_t> input_key(const std::string &prefix) {
+    std::vector<uint64_t> key;
+    for (auto ext : {".bit", ".features"}) {
+        std::filesystem::path path(prefix + ext);
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        auto mtime = std::filesystem::last_write_time(path, ec);
+        key.push_back(ec ? 0 : uint64_t(size));
+        key.push_back(ec ? 0 : uint64_t(mtime.time_since_epoch().count()));
+    }
+    return key;
+}
+
+struct CacheWriter {
+    std::vector<char> buf;
+    idict<IdString> strings;
+    template <typename T> void put(T value) {
+        const char *p = reinterpret_cast<const char*>(&value);
+        buf.insert(buf.end(), p, p + sizeof(T));
+    }
+    void put_id(IdString id) { put<uint32_t>(strings(id)); }
+    void put_tile(const TileData &t) {
+        put_id(t.tile_type);
+        put<int32_t>(t.frames);
+        put<int32_t>(t.bits);
+        put<int32_t>(t.set_bits.size());
+        for (auto w : t.set_bits.words)
+            put<uint64_t>(w);
+    }
+};
+
+struct CacheReader {
+    const char *ptr, *end;
+    std::vector<IdString> strings;
+    bool ok = true;
+    template <typename T> T get() {
+        T value{};
+        if (end - ptr < index_t(sizeof(T))) {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, ptr, sizeof(T));
+        ptr += sizeof(T);
+        return value;
+    }
+    IdString get_id() {
+        uint32_t idx = get<uint32_t>();
+        if (idx >= strings.size()) {
+            ok = false;
+            return IdString();
+        }
+        return strings.at(idx);
+    }
+    TileData get_tile() {
+        TileData t;
+        t.tile_type = get_id();
+        t.frames = get<int32_t>();
+        t.bits = get<int32_t>();
+        t.set_bits = BitVector(std::max(0, get<int32_t>()));
+        for (auto &w : t.set_bits.words)
+            w = get<uint64_t>();
+        return t;
+    }
+};
+
+bool parse_cache(Context *ctx, CacheReader &rd, const std::vector<uint64_t> &key, TileGrid &bits, TileFeatures &feats) {
+    if (rd.get<uint64_t>() != cache_magic)
+        return false;
+    for (auto k : key)
+        if (rd.get<uint64_t>() != k)
+            return false;
+    uint32_t idcode = rd.get<uint32_t>();
+    bits.dev = device_by_idcode(idcode);
+    if (!bits.dev)
+        return false;
+    uint32_t num_strings = rd.get<uint32_t>();
+    for (uint32_t i = 0; i < num_strings && rd.ok; i++) {
+        uint32_t len = rd.get<uint32_t>();
+        if (rd.end - rd.ptr < index_t(len))
+            return false;
+        rd.strings.push_back(ctx->id(std::string(rd.ptr, len)));
+        rd.ptr += len;
+    }
+    auto get_key = [&]() {
+        TileKey k;
+        k.prefix = rd.get_id();
+        k.x = rd.get<int16_t>();
+        k.y = rd.get<int16_t>();
+        return k;
+    };
+    uint32_t num_tiles = rd.get<uint32_t>();
+    for (uint32_t i = 0; i < num_tiles && rd.ok; i++) {
+        auto k = get_key();
+        bits.tiles[k] = rd.get_tile();
+    }
+    uint32_t num_defaults = rd.get<uint32_t>();
+    for (uint32_t i = 0; i < num_defaults && rd.ok; i++) {
+        auto tt = rd.get_id();
+        bits.defaults[tt] = rd.get_tile();
+    }
+    uint32_t num_feat_tiles = rd.get<uint32_t>();
+    for (uint32_t i = 0; i < num_feat_tiles && rd.ok; i++) {
+        auto &tile_feats = feats.tiles[get_key()];
+        uint32_t num_feats = rd.get<uint32_t>();
+        for (uint32_t j = 0; j < num_feats && rd.ok; j++) {
+            IdString base = rd.get_id();
+            tile_feats.insert(Feature(base, rd.get<int32_t>()));
+        }
+    }
+    return rd.ok;
+}
+
+}
+
+bool read_specimen_cache(Context *ctx, const std::string &prefix, TileGrid &bits, TileFeatures &feats) {
+    std::string filename = prefix + ".meowcache";
+    auto key = input_key(prefix);
+    bool result = false;
+#if !defined(_WIN32)
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            CacheReader rd{static_cast<const char*>(data), static_cast<const char*>(data) + st.st_size};
+            result = parse_cache(ctx, rd, key, bits, feats);
+            munmap(data, st.st_size);
+        }
+    }
+    close(fd);
+#else
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        return false;
+    std::vector<char> buf(std::istreambuf_iterator<char>(in), {});
+    CacheReader rd{buf.data(), buf.data() + buf.size()};
+    result = parse_cache(ctx, rd, key, bits, feats);
+#endif
+    if (!result) {
+        // don't leave a partial result behind
+        bits = TileGrid();
+        feats = TileFeatures();
+    }
+    return result;
+}
+
+void write_specimen_cache(Context *ctx, const std::string &prefix, const TileGrid &bits, const TileFeatures &feats) {
+    CacheWriter wr;
+    // the body is written first so the string table is complete, then the header
+    CacheWriter body;
+    auto put_key = [&](TileKey k) {
+        body.put_id(k.prefix);
+        body.put<int16_t>(k.x);
+        body.put<int16_t>(k.y);
+    };
+    // hashlib containers iterate in reverse insertion order, so write everything reversed to get the same
+    // order back when reading; this keeps results identical between cached and uncached runs
+    auto reversed = [](const auto &container) {
+        std::vector<std::remove_reference_t<decltype(*container.begin())>*> result;
+        for (auto &entry : container)
+            result.push_back(&entry);
+        std::reverse(result.begin(), result.end());
+        return result;
+    };
+    body.put<uint32_t>(bits.tiles.size());
+    for (auto t : reversed(bits.tiles)) {
+        put_key(t->first);
+        body.put_tile(t->second);
+    }
+    body.put<uint32_t>(bits.defaults.size());
+    for (auto t : reversed(bits.defaults)) {
+        body.put_id(t->first);
+        body.put_tile(t->second);
+    }
+    body.put<uint32_t>(feats.tiles.size());
+    for (auto t : reversed(feats.tiles)) {
+        put_key(t->first);
+        body.put<uint32_t>(t->second.size());
+        for (auto f : reversed(t->second)) {
+            body.put_id(f->base);
+            body.put<int32_t>(f->bit);
+        }
+    }
+    wr.put<uint64_t>(cache_magic);
+    for (auto k : input_key(prefix))
+        wr.put<uint64_t>(k);
+    wr.put<uint32_t>(bits.dev ? bits.dev->idcode : 0);
+    wr.put<uint32_t>(body.strings.size());
+    for (auto id : body.strings) {
+        const std::string &s = id.str(ctx);
+        wr.put<uint32_t>(s.size());
+        wr.buf.insert(wr.buf.end(), s.begin(), s.end());
+    }
+    wr.buf.insert(wr.buf.end(), body.buf.begin(), body.buf.end());
+    // write to a temporary file and rename, so readers never see a partial cache
+    std::string filename = prefix + ".meowcache";
+    {
+        std::ofstream out(filename + ".tmp", std::ios::binary);
+        if (!out) {
+            log_warning("failed to write cache '%s'\n", filename.c_str());
+            return;
+        }
+        out.write(wr.buf.data(), wr.buf.size());
+    }
+    std::error_code ec;
+    std::filesystem::rename(filename + ".tmp", filename, ec);
+    if (ec)
+        log_warning("failed to write cache '%s'\n", filename.c_str());
+}
+
+MEOW_NAMESPACE_END
@@ -0,0 +1,23 @@
+#ifndef SPEC_CACHE_H
+#define SPEC_CACHE_H
+
+#include "preface.h"
+#include "tile.h"
+#include "feature.h"
+
+#include <string>
+
+MEOW_NAMESPACE_BEGIN
+
+struct Context;
+
+// Binary cache of a decoded specimen (tile bits and features), stored as <prefix>.meowcache next to the
+// <prefix>.bit and <prefix>.features it was made from. It is only used if the size and mtime of both inputs match.
+
+// returns false if there is no valid cache
+bool read_specimen_cache(Context *ctx, const std::string &prefix, TileGrid &bits, TileFeatures &feats);
+void write_specimen_cache(Context *ctx, const std::string &prefix, const TileGrid &bits, const TileFeatures &feats);
+
+MEOW_NAMESPACE_END
+
+#endif
@@ -1,147 +1,655 @@
 #include "specimen.h"
+#include "context.h"
+#include "log.h"
+#include <algorithm>
+#include <charconv>
 #include <iostream>
 MEOW_NAMESPACE_BEGIN
 
+namespace {
+// by name then bit; unlike feature_idx order, this doesn't depend on the order specimens were loaded in
+bool feature_less(const Context *ctx, Feature a, Feature b) {
+    const auto &sa = a.base.str(ctx), &sb = b.base.str(ctx);
+    return (sa < sb) || ((sa == sb) && a.bit < b.bit);
+}
+
+// solve order: fewest dependencies first, then most often seen, then by name so ties are deterministic
+template <typename TDeps, typename TCount>
+void sort_solve_order(const Context *ctx, std::vector<Feature> &to_solve, TDeps deps, TCount count) {
+    std::sort(to_solve.begin(), to_solve.end(), [&](Feature a, Feature b) {
+        index_t da = deps(a), db = deps(b);
+        if (da != db)
+            return da < db;
+        index_t ca = count(a), cb = count(b);
+        if (ca != cb)
+            return ca > cb;
+        return feature_less(ctx, a, b);
+    });
+}
+
+void write_solution(Context *ctx, std::ostream &out, int tile_bits, const std::vector<Feature> &to_solve, const idict<Feature> &feature_idx,
+        const std::vector<BitVector> &result, const std::vector<index_t> &dep_count, const std::vector<index_t> &feature_count,
+        index_t min_count, const std::vector<index_t> &bit_count, const std::vector<index_t> &feat_class = {},
+        const std::vector<bool> &bus_filled = {}) {
+    // sort nicely
+    std::vector<Feature> to_print(to_solve.begin(), to_solve.end());
+
+    std::sort(to_print.begin(), to_print.end(), [&](Feature a, Feature b) { return feature_less(ctx, a, b); });
+
+    dict<index_t, std::vector<Feature>> class_members;
+    for (auto feat : to_print)
+        if (!feat_class.empty())
+            class_members[feat_class.at(feature_idx.at(feat))].push_back(feat);
+
+    for (auto feat : to_print) {
+        index_t f = feature_idx.at(feat);
+        bool filled = !bus_filled.empty() && bus_filled.at(f);
+        if (feature_count.at(f) < min_count && !filled)
+            continue; // too unrealiable to print...
+        feat.write(ctx, out);
+        for (auto bit : result.at(f))
+            out << " " << (bit / tile_bits) << "_" << (bit % tile_bits);
+        out << " # deps: " << dep_count.at(f);
+        out << ", count: " << feature_count.at(f);
+        if (result.at(f).any()) {
+            // every specimen with the feature has the bit set by construction; so the confidence of each bit is the
+            // fraction of specimens with the bit set that also have the feature
+            out << ", conf:";
+            for (auto bit : result.at(f)) {
+                out << stringf(" %.2f", double(feature_count.at(f)) / std::max<index_t>(1, bit_count.at(bit)));
+            }
+        }
+        if (!feat_class.empty() && class_members.at(feat_class.at(f)).size() > 1) {
+            // features always seen together, so the bits can't be assigned to one of them in particular
+            out << ", equiv:";
+            for (auto other : class_members.at(feat_class.at(f))) {
+                if (other == feat)
+                    continue;
+                out << " ";
+                other.write(ctx, out);
+            }
+        }
+        if (filled)
+            out << ", bus";
+        out << std::endl;
+    }
+}
+
+// Indexed features of the same base (e.g. INIT[0] to INIT[63]) usually map to bits at a regular stride, bit(i) =
+// offset + stride * i. The stride is fitted by a vote over the members already solved to exactly one bit, and only
+// accepted if every one of them agrees with it; it is then used to fill in the other members (empty, ambiguous or
+// seen in too few specimens). A predicted bit is only used if consistent(f, bit) - it is set in every specimen with
+// the member - and it isn't already in the result of another feature; for ambiguous members it must also be one of
+// the candidates. Returns which features were filled in.
+template <typename TConsistent>
+std::vector<bool> solve_buses(Context *ctx, const std::vector<Feature> &to_solve, const idict<Feature> &feature_idx,
+        std::vector<BitVector> &result, const std::vector<index_t> &feature_count, index_t min_count, index_t num_bits,
+        TConsistent consistent) {
+    std::vector<bool> filled(feature_idx.size(), false);
+    // bits already in some feature's result, so a fill never gives the same bit to two features
+    std::vector<index_t> claimed_by(num_bits, -1);
+    for (index_t f = 0; f < index_t(result.size()); f++) {
+        if (feature_count.at(f) < min_count || result.at(f).size() == 0)
+            continue;
+        for (auto bit : result.at(f))
+            claimed_by.at(bit) = (claimed_by.at(bit) == -1) ? f : -2; // -2: more than one feature
+    }
+    dict<IdString, std::vector<Feature>> buses;
+    std::vector<IdString> bus_order;
+    for (auto feat : to_solve) {
+        if (feat.bit < 0)
+            continue;
+        auto &members = buses[feat.base];
+        if (members.empty())
+            bus_order.push_back(feat.base);
+        members.push_back(feat);
+    }
+    for (auto base : bus_order) {
+        auto &members = buses.at(base);
+        if (members.size() < 3)
+            continue;
+        std::sort(members.begin(), members.end(), [](Feature a, Feature b) { return a.bit < b.bit; });
+        auto is_solved = [&](index_t f) {
+            return feature_count.at(f) >= min_count && result.at(f).size() > 0 && result.at(f).count() == 1;
+        };
+        std::vector<std::pair<index_t, index_t>> points; // (member index, bit)
+        for (auto feat : members) {
+            index_t f = feature_idx.at(feat);
+            if (is_solved(f))
+                points.emplace_back(feat.bit, *result.at(f).begin());
+        }
+        if (points.size() < 2)
+            continue;
+        // each pair of neighbouring solved members votes for a (stride, offset)
+        dict<std::pair<index_t, index_t>, index_t> votes;
+        for (size_t i = 1; i < points.size(); i++) {
+            index_t di = points.at(i).first - points.at(i - 1).first;
+            index_t db = points.at(i).second - points.at(i - 1).second;
+            if (db == 0 || db % di != 0)
+                continue;
+            index_t stride = db / di;
+            ++votes[std::make_pair(stride, points.at(i - 1).second - stride * points.at(i - 1).first)];
+        }
+        std::pair<index_t, index_t> fit;
+        index_t best = 0;
+        for (auto &v : votes)
+            if (v.second > best || (v.second == best && v.first < fit)) {
+                fit = v.first;
+                best = v.second;
+            }
+        index_t fitted = 0;
+        for (auto &pt : points)
+            if (fit.second + fit.first * pt.first == pt.second)
+                ++fitted;
+        // a single independently solved member that disagrees means the bus isn't a simple stride
+        if (best == 0 || fitted < 3 || fitted != index_t(points.size())) {
+            log_verbose("    bus %s: no stride fits all %d solved members, left as is\n", base.c_str(ctx), int(points.size()));
+            continue;
+        }
+        index_t num_filled = 0, num_claimed = 0;
+        for (auto feat : members) {
+            index_t f = feature_idx.at(feat);
+            index_t bit = fit.second + fit.first * feat.bit;
+            if (bit < 0 || bit >= num_bits)
+                continue;
+            if (is_solved(f))
+                continue; // agrees, checked above
+            auto &r = result.at(f);
+            bool ambiguous = feature_count.at(f) >= min_count && r.size() > 0 && r.any();
+            if ((ambiguous && !r.get(bit)) || !consistent(f, bit))
+                continue;
+            if (claimed_by.at(bit) != -1 && claimed_by.at(bit) != f) {
+                ++num_claimed;
+                continue;
+            }
+            r = BitVector(num_bits);
+            r.set(bit);
+            claimed_by.at(bit) = f;
+            filled.at(f) = true;
+            ++num_filled;
+        }
+        log_verbose("    bus %s: stride %d, offset %d fits all %d solved members, %d filled in, %d skipped as already "
+                "claimed\n", base.c_str(ctx), fit.first, fit.second, fitted, num_filled, num_claimed);
+    }
+    return filled;
+}
+}
+
 void SpecimenGroup::find_deps() {
+    build_matrix();
+    // the dependencies of a feature are the intersection of the feature rows of all specimens containing it
     dependencies.clear();
-    std::vector<Feature> to_erase;
-    for (auto spec : specs) {
-        for (auto feat : spec.features) {
-            if (!dependencies.count(feat)) {
-                // add all other set features in specimen as dependencies
-                auto &deps = dependencies[feat];
-                for (auto feat2 : spec.features) {
-                    if (feat2 != feat)
-                        deps.insert(feat2);
-                }
-            } else {
-                // remove features not set as dependencies
-                to_erase.clear();
-                for (auto dep : dependencies.at(feat))
-                    if (!spec.features.count(dep))
-                        to_erase.push_back(dep);
-                for (auto eliminated : to_erase)
-                    dependencies.at(feat).erase(eliminated);
-            }
+    feat_deps.resize(feature_idx.size());
+    for (index_t f = 0; f < index_t(feature_idx.size()); f++) {
+        auto &deps = feat_deps.at(f);
+        deps = BitVector(feature_idx.size(), true);
+        for (index_t s : feat_specs.at(f))
+            deps &= spec_feats.at(s);
+        deps.set(f, false);
+        auto &dep_pool = dependencies[feature_idx[f]];
+        for (index_t d : deps)
+            dep_pool.insert(feature_idx[d]);
+    }
+}
+
+void SpecimenGroup::add(const pool<Feature> &features, const BitVector &set_bits) {
+    SpecimenData spec;
+    for (auto feat : features)
+        spec.features.push_back(feature_idx(feat));
+    std::sort(spec.features.begin(), spec.features.end());
+    unsigned h = set_bits.hash();
+    for (index_t f : spec.features)
+        h = mkhash(h, f);
+    total_weight += 1;
+    auto &candidates = spec_by_hash[h];
+    for (index_t i : candidates) {
+        auto &other = specs.at(i);
+        if (other.features == spec.features && other.set_bits == set_bits) {
+            ++other.weight;
+            return;
+        }
+    }
+    candidates.push_back(index_t(specs.size()));
+    spec.set_bits = set_bits;
+    specs.push_back(std::move(spec));
+}
+
+void SpecimenGroup::build_matrix() {
+    log_verbose("    %d specimens, %d distinct\n", int(total_weight), int(specs.size()));
+    index_t num_feats = index_t(feature_idx.size()), num_specs = index_t(specs.size());
+    spec_feats.assign(num_specs, BitVector(num_feats));
+    feat_specs.assign(num_feats, BitVector(num_specs));
+    for (index_t s = 0; s < num_specs; s++) {
+        MEOW_ASSERT(specs.at(s).set_bits.size() == specs.front().set_bits.size());
+        for (index_t f : specs.at(s).features) {
+            spec_feats.at(s).set(f);
+            feat_specs.at(f).set(s);
         }
     }
 }
 
-void SpecimenGroup::solve(Context *ctx) {
+void SpecimenGroup::solve(Context *ctx, std::ostream &out) {
+    if (feat_deps.size() != feature_idx.size() || spec_feats.size() != specs.size())
+        find_deps();
+    index_t num_bits = specs.empty() ? 0 : specs.front().set_bits.size();
     // sort by fewest dependencies first
     std::vector<Feature> to_solve;
     dict<Feature, index_t> feature_count;
     for (auto &dep : dependencies)
         to_solve.push_back(dep.first);
+    // weighted, so counts are of specimens before deduplication
+    std::vector<index_t> count(feature_idx.size(), 0);
+    for (index_t f = 0; f < index_t(feature_idx.size()); f++)
+        for (index_t s : feat_specs.at(f))
+            count.at(f) += specs.at(s).weight;
+    for (auto feat : to_solve)
+        feature_count[feat] = count.at(feature_idx.at(feat));
+    sort_solve_order(ctx, to_solve, [&](Feature f) { return index_t(dependencies.at(f).size()); },
+            [&](Feature f) { return feature_count.at(f); });
+    // Features that are in exactly the same specimens can't be told apart. Each is a dependency of the others, so
+    // only the first of such a class in solve order can end up with any bits; only that one is actually solved.
+    std::vector<index_t> feat_class(feature_idx.size(), -1);
+    dict<BitVector, index_t> class_rep;
     for (auto feat : to_solve) {
-        for (auto &spec : specs) {
-            if (!spec.features.count(feat))
-                continue;
-            ++feature_count[feat];
+        index_t f = feature_idx.at(feat);
+        auto found = class_rep.find(feat_specs.at(f));
+        if (found == class_rep.end())
+            found = class_rep.emplace(feat_specs.at(f), f).first;
+        feat_class.at(f) = found->second;
+    }
+    log_verbose("    %d features in %d equivalence classes\n", int(to_solve.size()), int(class_rep.size()));
+    // Reduce the specimen x bit matrix to the columns that matter. Bits clear in every specimen can't be a candidate
+    // of anything. Bits set in every specimen, if some feature is also in every specimen, always end up with the first
+    // such feature solved (it is a dependency of everything else), so they are given to it directly.
+    index_t num_specs = index_t(specs.size());
+    BitVector any_set(num_bits), all_set(num_bits, true);
+    for (auto &spec : specs) {
+        any_set |= spec.set_bits;
+        all_set &= spec.set_bits;
+    }
+    index_t first_always = -1;
+    for (auto feat : to_solve) {
+        if (feature_count.at(feat) == total_weight) {
+            first_always = feature_idx.at(feat);
+            break;
         }
     }
-    std::stable_sort(to_solve.begin(), to_solve.end(), [&](Feature a, Feature b) {
-        int da = dependencies.at(a).size();
-        int db = dependencies.at(b).size();
-        return (da < db) || ((da == db) && (feature_count.at(a) >= feature_count.at(b)));
-    });
-    dict<Feature, pool<index_t>> result;
-    pool<index_t> set_with_feature, already_explained;
-    std::vector<index_t> to_remove;
+    BitVector active = any_set;
+    if (first_always != -1)
+        active.and_not(all_set);
+    std::vector<index_t> active_bits; // compact index -> tile bit
+    std::vector<index_t> compact_idx(num_bits, -1);
+    for (auto bit : active) {
+        compact_idx.at(bit) = index_t(active_bits.size());
+        active_bits.push_back(bit);
+    }
+    index_t num_active = index_t(active_bits.size());
+    std::vector<BitVector> spec_bits(num_specs, BitVector(num_active));
+    for (index_t s = 0; s < num_specs; s++)
+        for (auto bit : specs.at(s).set_bits)
+            if (compact_idx.at(bit) != -1)
+                spec_bits.at(s).set(compact_idx.at(bit));
+    // candidate bits are those set in every specimen with the feature, and not explained by an already solved dependency
+    std::vector<BitVector> result(feature_idx.size());
+    std::vector<bool> solved(feature_idx.size(), false);
     for (auto feat : to_solve) {
-        bool found = false;
-        set_with_feature.clear();
-        already_explained.clear();
-        for (auto &spec : specs) {
-            if (!spec.features.count(feat))
-                continue;
-            if (!found) {
-                // first time we hit feature, add all not set in dependent features
-                for (auto set : spec.set_bits)
-                    set_with_feature.insert(set);
-                for (auto dep : dependencies.at(feat)) {
-                    if (!result.count(dep))
-                        continue;
-                    for (auto dep_bit : result.at(dep))
-                        set_with_feature.erase(dep_bit);
-                }
-                found = true;
-            } else {
-                to_remove.clear();
-                // remove candidates not set in this specimen
-                for (auto cand_bit : set_with_feature)
-                    if (!spec.set_bits.count(cand_bit))
-                        to_remove.push_back(cand_bit);
-                for (auto unset_bit : to_remove)
-                    set_with_feature.erase(unset_bit);
-            }
+        index_t f = feature_idx.at(feat);
+        auto &cand = result.at(f);
+        if (feat_class.at(f) != f) {
+            cand = BitVector(num_active);
+            solved.at(f) = true;
+            continue;
         }
-        for (auto &spec : specs) {
-            if (!spec.features.count(feat))
-                continue;
+        cand = BitVector(num_active, feature_count.at(feat) != total_weight); // features in every specimen are handled above
+        for (index_t s : feat_specs.at(f)) {
+            if (cand.none())
+                break;
+            cand &= spec_bits.at(s);
         }
-        result[feat] = set_with_feature;
-    }
-    // eliminate already explained (TODO: speedup ?)
-    dict<index_t, pool<Feature>> bit2feat;
-    for (auto &r : result) {
-        for (auto bit : r.second)
-            bit2feat[bit].insert(r.first);
+        for (index_t d : feat_deps.at(f)) {
+            if (solved.at(d))
+                cand.and_not(result.at(d));
+        }
+        solved.at(f) = true;
     }
+    // eliminate already explained, using an inverted index from each bit to the features it is a candidate for
+    std::vector<BitVector> bit_feats(num_active, BitVector(feature_idx.size()));
+    for (index_t f = 0; f < index_t(result.size()); f++)
+        for (auto bit : result.at(f))
+            bit_feats.at(bit).set(f);
+    std::vector<BitVector> explained(result.size());
+    BitVector other_feats;
     for (auto feat : to_solve) {
-        if (!result.count(feat))
+        index_t f = feature_idx.at(feat);
+        // features below the threshold still explain bits for others, but aren't solved further or printed; features
+        // that aren't the representative of their class have no bits to begin with
+        if (feature_count.at(feat) < min_count || feat_class.at(f) != f) {
+            explained.at(f) = BitVector(num_active);
             continue;
-        auto &feat_bits = result[feat];
-        pool<index_t> feat_already_explained = feat_bits;
-        std::vector<index_t> unexplained;
-        for (auto &spec : specs) {
-            if (!spec.features.count(feat))
-                continue;
-            if (feat_already_explained.empty())
+        }
+        // bits that, in every specimen with the feature, are also candidates of another feature of that specimen
+        auto &feat_already_explained = explained.at(f);
+        feat_already_explained = result.at(f);
+        for (index_t s : feat_specs.at(f)) {
+            if (feat_already_explained.none())
                 break; // don't waste effort
-            unexplained.clear();
+            other_feats = spec_feats.at(s);
+            other_feats.set(f, false);
             for (auto ae_bit : feat_already_explained) {
-                bool is_explained = false;
-                for (auto &overlap_feat : bit2feat.at(ae_bit)) {
-                    if (overlap_feat == feat)
-                        continue;
-                    if (spec.features.count(overlap_feat)) {
-                        is_explained = true;
-                        break;
-                    }
-                }
-                if (!is_explained)
-                    unexplained.push_back(ae_bit);
+                if (!bit_feats.at(ae_bit).intersects(other_feats))
+                    feat_already_explained.set(ae_bit, false);
             }
-            for (auto ue_bit : unexplained)
-                feat_already_explained.erase(ue_bit);
         }
-        for (auto ae_bit : feat_already_explained)
-            feat_bits.erase(ae_bit);
     }
-    // sort nicely
-    std::vector<Feature> to_print(to_solve.begin(), to_solve.end());
+    // back to tile bits
+    std::vector<BitVector> tile_result(result.size(), BitVector(num_bits));
+    for (index_t f = 0; f < index_t(result.size()); f++) {
+        result.at(f).and_not(explained.at(f));
+        for (auto bit : result.at(f))
+            tile_result.at(f).set(active_bits.at(bit));
+    }
+    if (first_always != -1)
+        tile_result.at(first_always) |= all_set;
+    std::vector<index_t> dep_count(feature_idx.size());
+    for (index_t f = 0; f < index_t(feature_idx.size()); f++)
+        dep_count.at(f) = feat_deps.at(f).count();
+    std::vector<index_t> bit_count(num_bits, 0);
+    for (auto &spec : specs)
+        for (auto bit : spec.set_bits)
+            bit_count.at(bit) += spec.weight;
+    std::vector<bool> bus_filled;
+    if (bus_aware)
+        bus_filled = solve_buses(ctx, to_solve, feature_idx, tile_result, count, min_count, num_bits, [&](index_t f, index_t bit) {
+            for (index_t s : feat_specs.at(f))
+                if (!specs.at(s).set_bits.get(bit))
+                    return false;
+            return true;
+        });
+    write_solution(ctx, out, tile_bits, to_solve, feature_idx, tile_result, dep_count, count, min_count, bit_count, feat_class,
+        bus_filled);
+}
 
-    std::sort(to_print.begin(), to_print.end(), [&](const Feature &a, const Feature &b) {
-        const auto &sa = a.base.str(ctx), &sb = b.base.str(ctx);
-        return (sa < sb) || ((sa == sb) && a.bit < b.bit);
-    });
+void SpecimenAccumulator::add(const pool<Feature> &features, const BitVector &set_bits) {
+    std::unique_lock lock(mutex);
+    ++num_specs;
+    if (index_t(bit_count.size()) < set_bits.size())
+        bit_count.resize(set_bits.size(), 0);
+    for (auto bit : set_bits)
+        ++bit_count.at(bit);
+    std::vector<index_t> feat_indices;
+    for (auto feat : features)
+        feat_indices.push_back(feature_idx(feat));
+    grow_features();
+    BitVector row(feat_capacity);
+    for (index_t f : feat_indices)
+        row.set(f);
+    for (index_t f : feat_indices) {
+        if (f == index_t(feat_count.size())) {
+            // first time we hit feature
+            feat_count.push_back(0);
+            feat_deps.push_back(row);
+            feat_bits.push_back(set_bits);
+        } else {
+            feat_deps.at(f) &= row;
+            feat_bits.at(f) &= set_bits;
+        }
+        ++feat_count.at(f);
+    }
+}
 
-    for (auto feat : to_print) {
-        // TODO: save properly
-        if (feature_count.at(feat) <= 1)
-            continue; // too unrealiable to print...
-        feat.write(ctx, std::cout);
-        for (auto bit : result.at(feat))
-            std::cout << " " << (bit / tile_bits) << "_" << (bit % tile_bits);
-        std::cout << " # deps: " << dependencies.at(feat).size();
-        std::cout << ", count: " << feature_count.at(feat);
-        /*for (auto dep : dependencies.at(feat)) {
-            dep.write(ctx, std::cout);
-            std::cout << ", ";
-        }*/
-        std::cout << std::endl;
+void SpecimenAccumulator::grow_features() {
+    if (index_t(feature_idx.size()) <= feat_capacity)
+        return;
+    // grow geometrically; features first seen later can never be dependencies of earlier ones, so new bits are clear
+    feat_capacity = std::max<index_t>(64, 2 * feature_idx.size());
+    for (auto &deps : feat_deps)
+        deps.resize(feat_capacity);
+}
+
+void SpecimenAccumulator::merge(const SpecimenAccumulator &other) {
+    std::unique_lock lock(mutex);
+    std::vector<index_t> feat_map;
+    for (auto feat : other.feature_idx)
+        feat_map.push_back(feature_idx(feat));
+    grow_features();
+    for (index_t g = 0; g < index_t(feat_map.size()); g++) {
+        index_t f = feat_map.at(g);
+        BitVector row(feat_capacity);
+        for (index_t d : other.feat_deps.at(g))
+            row.set(feat_map.at(d));
+        if (f == index_t(feat_count.size())) {
+            // new feature, never in any of our specimens
+            feat_count.push_back(other.feat_count.at(g));
+            feat_deps.push_back(row);
+            feat_bits.push_back(other.feat_bits.at(g));
+        } else {
+            // features only we have are cleared by the AND, as none of the other specimens with f had them
+            feat_count.at(f) += other.feat_count.at(g);
+            feat_deps.at(f) &= row;
+            feat_bits.at(f) &= other.feat_bits.at(g);
+        }
+    }
+    num_specs += other.num_specs;
+    if (bit_count.size() < other.bit_count.size())
+        bit_count.resize(other.bit_count.size(), 0);
+    for (index_t b = 0; b < index_t(other.bit_count.size()); b++)
+        bit_count.at(b) += other.bit_count.at(b);
+}
+
+std::string AccumulatorKey::str(const Context *ctx) const {
+    return site_type.empty() ? tile_type.str(ctx) : (tile_type.str(ctx) + "/" + site_type.str(ctx));
+}
+
+AccumulatorKey AccumulatorKey::parse(Context *ctx, std::string_view s) {
+    AccumulatorKey result;
+    auto pos = s.find('/');
+    result.tile_type = ctx->id(std::string(s.substr(0, pos)));
+    if (pos != std::string_view::npos)
+        result.site_type = ctx->id(std::string(s.substr(pos + 1)));
+    return result;
+}
+
+bool AccumulatorKey::less(const Context *ctx, const AccumulatorKey &other) const {
+    if (tile_type != other.tile_type)
+        return tile_type.str(ctx) < other.tile_type.str(ctx);
+    if (site_type.empty() || other.site_type.empty())
+        return site_type.empty() && !other.site_type.empty();
+    return site_type.str(ctx) < other.site_type.str(ctx);
+}
+
+void SpecimenAccumulator::write(Context *ctx, AccumulatorKey group, std::ostream &out) {
+    std::unique_lock lock(mutex);
+    out << ".group " << group.str(ctx) << " " << tile_bits << " " << bit_count.size() << " " << num_specs << std::endl;
+    out << ".bitcount";
+    for (index_t b = 0; b < index_t(bit_count.size()); b++)
+        if (bit_count.at(b))
+            out << " " << b << ":" << bit_count.at(b);
+    out << std::endl;
+    // features in name order, so the file doesn't depend on the order specimens were added in; deps are given as
+    // positions in that order, to keep them short
+    std::vector<index_t> order(feature_idx.size()), position(feature_idx.size());
+    for (index_t f = 0; f < index_t(order.size()); f++)
+        order.at(f) = f;
+    std::sort(order.begin(), order.end(), [&](index_t a, index_t b) { return feature_less(ctx, feature_idx[a], feature_idx[b]); });
+    for (index_t p = 0; p < index_t(order.size()); p++)
+        position.at(order.at(p)) = p;
+    std::vector<index_t> deps;
+    for (index_t f : order) {
+        feature_idx[f].write(ctx, out);
+        out << " " << feat_count.at(f) << " .bits";
+        for (auto bit : feat_bits.at(f))
+            out << " " << bit;
+        deps.clear();
+        for (index_t d : feat_deps.at(f))
+            if (d != f)
+                deps.push_back(position.at(d));
+        std::sort(deps.begin(), deps.end());
+        out << " .deps";
+        for (index_t d : deps)
+            out << " " << d;
+        out << std::endl;
+    }
+}
+
+void read_partials(Context *ctx, const std::string &filename, line_range lines, dict<AccumulatorKey, std::unique_ptr<SpecimenAccumulator>> &accs) {
+    AccumulatorKey group;
+    std::unique_ptr<SpecimenAccumulator> acc;
+    // deps are positions in the group and may refer to later features, so rows are filled in once it is complete
+    std::vector<std::vector<index_t>> deps;
+    std::vector<index_t> feat_lines;
+    index_t line_no = 1, line_pos = lines.offset;
+    auto fail_at = [&](index_t at_line, const std::string &msg) {
+        log_error("%s:%d: %s in partial result\n", filename.c_str(), at_line, msg.c_str());
+    };
+    auto fail = [&](const std::string &msg) { fail_at(line_no, msg); };
+    // the writer only produces non-negative decimal numbers, so anything else means a damaged file
+    auto parse_number = [&](std::string_view word, const char *what) {
+        int32_t value = 0;
+        auto [end, err] = std::from_chars(word.data(), word.data() + word.size(), value);
+        if (err != std::errc() || end != word.data() + word.size() || value < 0)
+            fail(stringf("bad %s '%s'", what, std::string(word).c_str()));
+        return index_t(value);
+    };
+    auto next_word = [&](word_range &line, word_iterator &i, const char *what) {
+        if (i == line.end())
+            fail(stringf("missing %s", what));
+        return *i++;
+    };
+    auto finish_group = [&]() {
+        if (!acc)
+            return;
+        acc->grow_features();
+        for (index_t f = 0; f < index_t(deps.size()); f++) {
+            auto &row = acc->feat_deps.at(f);
+            row = BitVector(acc->feat_capacity);
+            row.set(f);
+            for (index_t dep : deps.at(f)) {
+                if (dep >= index_t(deps.size()))
+                    fail_at(feat_lines.at(f), stringf("dependency %d out of range for %s", dep, group.str(ctx).c_str()));
+                row.set(dep);
+            }
+        }
+        auto &existing = accs[group];
+        if (existing)
+            existing->merge(*acc);
+        else
+            existing = std::move(acc);
+        acc.reset();
+        deps.clear();
+        feat_lines.clear();
+    };
+    for (auto l = lines.begin(); l != lines.end(); ++l) {
+        line_no += index_t(std::count(lines.buf.begin() + line_pos, lines.buf.begin() + l.pos, '\n'));
+        line_pos = l.pos;
+        auto line = *l;
+        auto i = line.begin();
+        if (i == line.end())
+            continue;
+        if (*i == ".group") {
+            finish_group();
+            ++i;
+            group = AccumulatorKey::parse(ctx, next_word(line, i, "group name"));
+            acc = std::make_unique<SpecimenAccumulator>();
+            acc->tile_bits = parse_number(next_word(line, i, "frame bits"), "frame bits");
+            acc->bit_count.assign(parse_number(next_word(line, i, "total bits"), "total bits"), 0);
+            acc->num_specs = parse_number(next_word(line, i, "specimen count"), "specimen count");
+            if (i != line.end())
+                fail(stringf("unexpected '%s' after .group", std::string(*i).c_str()));
+            // merging needs the same bit layout, so check now rather than once the group has been read
+            auto found = accs.find(group);
+            if (found != accs.end() && (found->second->tile_bits != acc->tile_bits ||
+                    found->second->bit_count.size() != acc->bit_count.size()))
+                fail(stringf("%s has %d frame bits and %d total, but %d and %d before", group.str(ctx).c_str(),
+                        acc->tile_bits, int(acc->bit_count.size()), found->second->tile_bits,
+                        int(found->second->bit_count.size())));
+            continue;
+        }
+        if (!acc)
+            fail("entry before any .group");
+        if (*i == ".bitcount") {
+            for (++i; i != line.end(); ++i) {
+                auto word = *i;
+                auto colon = word.find(':');
+                if (colon == std::string_view::npos)
+                    fail(stringf("expected bit:count, got '%s'", std::string(word).c_str()));
+                index_t bit = parse_number(word.substr(0, colon), "bit");
+                if (bit >= index_t(acc->bit_count.size()))
+                    fail(stringf("bit %d out of range", bit));
+                acc->bit_count.at(bit) = parse_number(word.substr(colon + 1), "bit count");
+            }
+            continue;
+        }
+        auto name = *i++;
+        auto br_pos = name.rfind('[');
+        if (br_pos != std::string_view::npos) {
+            if (name.back() != ']')
+                fail(stringf("bad feature '%s'", std::string(name).c_str()));
+            parse_number(name.substr(br_pos + 1, name.size() - (br_pos + 2)), "feature index");
+        }
+        Feature feat = Feature::parse(ctx, name);
+        if (acc->feature_idx.count(feat))
+            fail(stringf("duplicate feature '%s'", std::string(name).c_str()));
+        acc->feature_idx(feat);
+        acc->feat_count.push_back(parse_number(next_word(line, i, "feature count"), "feature count"));
+        BitVector bits(acc->bit_count.size());
+        deps.emplace_back();
+        feat_lines.push_back(line_no);
+        bool in_deps = false;
+        for (; i != line.end(); ++i) {
+            if (*i == ".bits" || *i == ".deps") {
+                in_deps = (*i == ".deps");
+                continue;
+            }
+            if (in_deps) {
+                deps.back().push_back(parse_number(*i, "dependency"));
+            } else {
+                index_t bit = parse_number(*i, "bit");
+                if (bit >= bits.size())
+                    fail(stringf("bit %d out of range", bit));
+                bits.set(bit);
+            }
+        }
+        acc->feat_bits.push_back(std::move(bits));
+        acc->feat_deps.emplace_back();
+    }
+    finish_group();
+}
+
+void SpecimenAccumulator::first_pass(const Context *ctx, std::vector<Feature> &to_solve, std::vector<BitVector> &result, std::vector<index_t> &dep_count) const {
+    index_t num_feats = index_t(feature_idx.size());
+    dep_count.assign(num_feats, 0);
+    for (index_t f = 0; f < num_feats; f++)
+        dep_count.at(f) = feat_deps.at(f).count() - 1; // the feature itself is always in its row
+    // sort by fewest dependencies first
+    to_solve.assign(feature_idx.begin(), feature_idx.end());
+    sort_solve_order(ctx, to_solve, [&](Feature f) { return dep_count.at(feature_idx.at(f)); },
+            [&](Feature f) { return feat_count.at(feature_idx.at(f)); });
+    result.assign(num_feats, BitVector());
+    std::vector<bool> solved(num_feats, false);
+    for (auto feat : to_solve) {
+        index_t f = feature_idx.at(feat);
+        if (feat_count.at(f) < min_count)
+            continue; // not printed, and can't be a dependency of a feature that is
+        result.at(f) = feat_bits.at(f);
+        for (index_t d : feat_deps.at(f)) {
+            if (d != f && solved.at(d))
+                result.at(f).and_not(result.at(d));
+        }
+        solved.at(f) = true;
     }
 }
 
+void SpecimenAccumulator::solve(Context *ctx, std::ostream &out) {
+    std::unique_lock lock(mutex);
+    std::vector<Feature> to_solve;
+    std::vector<BitVector> result;
+    std::vector<index_t> dep_count;
+    first_pass(ctx, to_solve, result, dep_count);
+    std::vector<bool> bus_filled;
+    if (bus_aware)
+        bus_filled = solve_buses(ctx, to_solve, feature_idx, result, feat_count, min_count, bit_count.size(),
+            [&](index_t f, index_t bit) { return feat_bits.at(f).get(bit); });
+    write_solution(ctx, out, tile_bits, to_solve, feature_idx, result, dep_count, feat_count, min_count, bit_count, {}, bus_filled);
+}
+
 MEOW_NAMESPACE_END
@@ -4,24 +4,98 @@
 #include "preface.h"
 #include "feature.h"
 #include "hashlib.h"
+#include "bitvector.h"
+#include "datafile.h"
+
+#include <iostream>
+#include <memory>
+#include <mutex>
 
 MEOW_NAMESPACE_BEGIN
 
-// For the correlation
+// For the correlation; owned and compact, so the full specimen can be freed once it has been added to its groups
 struct SpecimenData {
-    SpecimenData(const pool<Feature> &features, const pool<index_t> &set_bits) : features(features), set_bits(set_bits) {};
-    const pool<Feature> &features;
-    const pool<index_t> &set_bits;
+    std::vector<index_t> features; // sorted, indices into SpecimenGroup::feature_idx
+    BitVector set_bits;
+    index_t weight = 1; // number of identical specimens this stands for
 };
 
 struct SpecimenGroup {
     std::vector<SpecimenData> specs;
+    idict<Feature> feature_idx;
+    index_t total_weight = 0;
     dict<Feature, pool<Feature>> dependencies;
     int tile_bits = 48;
+    index_t min_count = 2; // features seen in fewer specimens are not solved
+    bool bus_aware = false; // fill in indexed features from the stride of the rest of their bus, see solve_buses in specimen.cc
+    // identical (features, bits) specimens are merged into one weighted entry; the solver only cares about distinct ones
+    void add(const pool<Feature> &features, const BitVector &set_bits);
     void find_deps();
-    void solve(Context *ctx);
+    void solve(Context *ctx, std::ostream &out);
+
+    // Dense matrix form of specs used by the solver; the specimen x bit matrix is the set_bits of each specimen
+    std::vector<BitVector> spec_feats; // specimen x feature
+    std::vector<BitVector> feat_specs; // feature x specimen
+    std::vector<BitVector> feat_deps; // feature x feature, the features set in every specimen the feature is
+    void build_matrix();
+
+  private:
+    dict<unsigned, std::vector<index_t>> spec_by_hash;
+};
+
+// Identifies a streaming group: a tile type, plus a site type when splitting tiles into sites, so they are grouped
+// the same as SpecimenGroups are by a full correlate run
+struct AccumulatorKey {
+    IdString tile_type, site_type; // site_type is empty if not splitting into sites
+    bool operator==(const AccumulatorKey &other) const { return tile_type == other.tile_type && site_type == other.site_type; }
+    bool operator!=(const AccumulatorKey &other) const { return !(*this == other); }
+    unsigned hash() const { return mkhash(tile_type.hash(), site_type.hash()); }
+    // header for the results, the same as a full run uses
+    IdString header() const { return site_type.empty() ? tile_type : site_type; }
+    // 'TILE_TYPE' or 'TILE_TYPE/SITE_TYPE'
+    std::string str(const Context *ctx) const;
+    static AccumulatorKey parse(Context *ctx, std::string_view s);
+    // by tile type then site type name, the order a full run prints groups in
+    bool less(const Context *ctx, const AccumulatorKey &other) const;
 };
 
+// Streaming counterpart of SpecimenGroup: only running per-feature intersections are kept, so specimens can be
+// dropped as soon as they have been added. Gives the find_deps and first solve pass results, but without the
+// elimination of already explained bits (which needs every specimen).
+struct SpecimenAccumulator {
+    int tile_bits = 48;
+    index_t min_count = 2;
+    bool bus_aware = false;
+    index_t num_specs = 0;
+    idict<Feature> feature_idx;
+    std::vector<index_t> feat_count;
+    std::vector<BitVector> feat_deps; // feature x feature; sized to feat_capacity
+    std::vector<BitVector> feat_bits; // feature x candidate bits
+    std::vector<index_t> bit_count; // number of specimens each bit is set in
+    index_t feat_capacity = 0;
+    std::mutex mutex;
+    // thread safe
+    void add(const pool<Feature> &features, const BitVector &set_bits);
+    // candidate bits of each feature (by feature_idx) after removing solved dependencies, empty for features below
+    // min_count; the caller must hold mutex if other threads may be adding
+    void first_pass(const Context *ctx, std::vector<Feature> &to_solve, std::vector<BitVector> &result, std::vector<index_t> &dep_count) const;
+    void solve(Context *ctx, std::ostream &out);
+
+    // Partial results, so correlation can be split over specimen ranges and combined exactly afterwards. The text
+    // form is a '.group KEY frame_bits total_bits specimens' line (KEY as AccumulatorKey::str), a '.bitcount bit:count...' line and then
+    // 'FEATURE count .bits bit... .deps position...' lines in feature name order, with bits as tile bit indices and
+    // deps as positions of other features in the group.
+    void write(Context *ctx, AccumulatorKey group, std::ostream &out);
+    // as if all the specimens added to other had been added here
+    void merge(const SpecimenAccumulator &other);
+    // make room in the dependency rows for all of feature_idx
+    void grow_features();
+};
+
+// reads partial results written by SpecimenAccumulator::write, merging groups that are already in accs; filename is
+// only used for error messages
+void read_partials(Context *ctx, const std::string &filename, line_range lines, dict<AccumulatorKey, std::unique_ptr<SpecimenAccumulator>> &accs);
+
 MEOW_NAMESPACE_END
 
 #endif
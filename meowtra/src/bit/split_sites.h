@@ -1,4 +1,4 @@
-#ifndef SITE_H
+#ifndef SPLIT_SITES_H
 #define SPLIT_SITES_H
 
 #include "feature.h"
@@ -6,15 +6,18 @@
 
 MEOW_NAMESPACE_BEGIN
 
+struct SiteSplitTable;
+
 struct SplitSite {
 	IdString site_type;
-	pool<index_t> set_bits;
+	index_t frame_bits; // bits per frame of set_bits
+	BitVector set_bits;
 	pool<Feature> set_features;
 };
 
-std::vector<SplitSite> split_sites(Context *ctx, IdString tile_type, const pool<index_t> &set_bits, const pool<Feature> &features);
+// splits a tile into its sites, in linear time in the number of set bits and features
+std::vector<SplitSite> split_sites(Context *ctx, const SiteSplitTable &table, const BitVector &set_bits, const pool<Feature> &features);
 
 MEOW_NAMESPACE_END
 
 #endif
-
@@ -4,6 +4,7 @@
 #include "database.h"
 #include "bitstream.h"
 #include "datafile.h"
+#include "tile_filter.h"
 
 MEOW_NAMESPACE_BEGIN
 
@@ -22,16 +23,35 @@ TileKey TileKey::parse(Context *ctx, const std::string_view &s) {
     return result;
 }
 
-TileGrid frames_to_tiles(Context *ctx, const BitstreamFrames &frames) {
+const TileData *TileGrid::get(TileKey key) const {
+    auto found = tiles.find(key);
+    if (found != tiles.end())
+        return &found->second;
+    auto found_default = defaults.find(key.prefix);
+    if (found_default != defaults.end())
+        return &found_default->second;
+    return nullptr;
+}
+
+TileGrid frames_to_tiles(Context *ctx, const BitstreamFrames &frames, const TileTypeFilter *filter) {
     TileGrid result;
-    auto regions = get_tile_regions(ctx, *frames.dev);
+    result.dev = frames.dev;
+    const auto &db = get_device_db(ctx, *frames.dev);
+    const auto &regions = db.tile_regions;
     for (const auto &r : regions) {
+        if (filter && !filter->match(ctx, r.prefix))
+            continue;
         std::vector<TileData> tiles(r.num_tiles);
         for (auto &t : tiles) {
             t.tile_type = r.prefix;
             t.bits = r.tile_height * 48;
             t.frames = r.tile_frames;
+            t.set_bits = BitVector(t.frames * t.bits);
         }
+        auto &tile_default = db.tile_defaults.at(r.prefix);
+        unsigned default_hash = tile_default.hash();
+        if (!result.defaults.count(r.prefix))
+            result.defaults[r.prefix] = TileData{.tile_type=r.prefix, .frames=r.tile_frames, .bits=index_t(r.tile_height * 48), .set_bits=tile_default};
         for (uint32_t f = 0; f < r.tile_frames; f++) {
             FrameKey k{r.slr, f + r.start_frame};
             if (!frames.frame_data.count(k)) {
@@ -44,7 +64,7 @@ TileGrid frames_to_tiles(Context *ctx, const BitstreamFrames &frames) {
                 auto &t = tiles.at(i);
                 for (index_t j = 0; j < (r.tile_height * 48); j++) {
                     if ((data.get(bit / 32U) >> (bit % 32U)) & 0x1) {
-                        t.set_bits.insert(f * t.bits + j);
+                        t.set_bits.set(f * t.bits + j);
                     }
                     bit++;
                     if (bit == 1440)
@@ -53,8 +73,10 @@ TileGrid frames_to_tiles(Context *ctx, const BitstreamFrames &frames) {
             }
         }
         for (index_t i = 0; i < r.num_tiles; i++) {
-            TileKey key{.prefix=r.prefix, .x=r.tile_x, .y=int16_t(r.tile_y0+i)};
-            result.tiles[key] = std::move(tiles.at(i));
+            auto &t = tiles.at(i);
+            if (t.set_bits.hash() == default_hash && t.set_bits == tile_default)
+                continue; // unconfigured
+            result.tiles[r.tile_key(i)] = std::move(t);
         }
     }
     return result;
@@ -5,6 +5,7 @@
 #include "idstring.h"
 #include "hashlib.h"
 #include "tile_key.h"
+#include "bitvector.h"
 
 #include <vector>
 
@@ -13,16 +14,25 @@ MEOW_NAMESPACE_BEGIN
 struct TileData {
     IdString tile_type;
     index_t frames, bits;
-    pool<index_t> set_bits;
+    BitVector set_bits; // frames * bits in size
 };
 
+struct Device;
+
 struct TileGrid {
+    const Device *dev = nullptr;
+    // only tiles that differ from their tile type default are stored
     dict<TileKey, TileData> tiles;
+    dict<IdString, TileData> defaults;
+    // returns the tile type default for tiles not stored, nullptr for tile types not in the grid
+    const TileData *get(TileKey key) const;
 };
 
 struct BitstreamFrames;
+struct TileTypeFilter;
 
-TileGrid frames_to_tiles(Context *ctx, const BitstreamFrames &frames);
+// tile types not selected by filter (if given) are skipped entirely
+TileGrid frames_to_tiles(Context *ctx, const BitstreamFrames &frames, const TileTypeFilter *filter = nullptr);
 
 MEOW_NAMESPACE_END
 
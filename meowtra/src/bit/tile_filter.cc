@@ -0,0 +1,114 @@
+#include "tile_filter.h"
+#include "context.h"
+#include "log.h"
+
+#include <string_view>
+
+MEOW_NAMESPACE_BEGIN
+
+namespace {
+
+bool glob_match(std::string_view pattern, std::string_view s) {
+    // iterative wildcard match, backtracking only to the most recent '*'
+    size_t p = 0, i = 0, star_p = std::string_view::npos, star_i = 0;
+    while (i < s.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == s[i])) {
+            ++p;
+            ++i;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star_p = p++;
+            star_i = i;
+        } else if (star_p != std::string_view::npos) {
+            p = star_p + 1;
+            i = ++star_i;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*')
+        ++p;
+    return p == pattern.size();
+}
+
+// FNV-1a, so shard assignment is stable between runs and builds (unlike IdString indices)
+uint32_t name_hash(const std::string &s) {
+    uint32_t h = 0x811c9dc5U;
+    for (char c : s)
+        h = (h ^ uint8_t(c)) * 0x01000193U;
+    return h;
+}
+
+}
+
+bool TileTypeFilter::Rule::match(const std::string &s) const {
+    return is_regex ? std::regex_match(s, regex) : glob_match(glob, s);
+}
+
+void TileTypeFilter::parse(const std::string &rule_str) {
+    std::string_view rest(rule_str);
+    while (!rest.empty()) {
+        size_t pos = rest.find(',');
+        std::string_view r = rest.substr(0, pos);
+        rest = (pos == std::string_view::npos) ? std::string_view() : rest.substr(pos + 1);
+        if (r.empty())
+            continue;
+        Rule rule;
+        if (r.front() == '!') {
+            rule.exclude = true;
+            r.remove_prefix(1);
+        }
+        if (r.substr(0, 3) == "re:") {
+            rule.is_regex = true;
+            try {
+                rule.regex = std::regex(std::string(r.substr(3)));
+            } catch (const std::regex_error &e) {
+                log_error("invalid tile type regex '%s': %s\n", std::string(r.substr(3)).c_str(), e.what());
+            }
+        } else {
+            rule.glob = std::string(r);
+        }
+        if (!rule.exclude)
+            has_include = true;
+        rules.push_back(std::move(rule));
+    }
+}
+
+void TileTypeFilter::set_shard(int index, int count) {
+    if (count < 1 || index < 0 || index >= count)
+        log_error("invalid shard %d/%d\n", index, count);
+    shard_index = index;
+    shard_count = count;
+}
+
+bool TileTypeFilter::evaluate(const std::string &tt_str) const {
+    if (shard_count > 1 && int(name_hash(tt_str) % uint32_t(shard_count)) != shard_index)
+        return false;
+    bool result = !has_include;
+    for (auto &rule : rules) {
+        if (!rule.match(tt_str))
+            continue;
+        if (rule.exclude)
+            return false;
+        result = true;
+    }
+    return result;
+}
+
+bool TileTypeFilter::match(const Context *ctx, IdString tile_type) const {
+    if (empty()) // include everything
+        return true;
+    {
+        std::shared_lock lock(mutex);
+        if (tile_type.index < index_t(verdicts.size()) && verdicts.at(tile_type.index) != -1)
+            return verdicts.at(tile_type.index);
+    }
+    // only the first lookup of each tile type gets here; rules are immutable so evaluating needs no lock
+    bool result = evaluate(tile_type.str(ctx));
+    std::unique_lock lock(mutex);
+    if (tile_type.index >= index_t(verdicts.size()))
+        verdicts.resize(tile_type.index + 1, -1);
+    verdicts.at(tile_type.index) = result;
+    return result;
+}
+
+MEOW_NAMESPACE_END
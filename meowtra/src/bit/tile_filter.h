@@ -0,0 +1,47 @@
+#ifndef TILE_FILTER_H
+#define TILE_FILTER_H
+
+#include "preface.h"
+#include "idstring.h"
+
+#include <cstdint>
+#include <regex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+MEOW_NAMESPACE_BEGIN
+
+struct Context;
+
+// Tile type selection rules, as given to -tiles: comma separated, each either a glob ('*' and '?' anywhere) or a
+// regex if prefixed with 're:'; a leading '!' makes a rule exclude. A tile type is selected if it matches any
+// including rule (or there are none) and no excluding rule. Results are memoised per tile type, in a table indexed
+// by IdString so the common case is a lookup under a shared lock.
+struct TileTypeFilter {
+    void parse(const std::string &rules);
+    // only select tile types whose name hashes to shard index of count, so separate processes can split a run
+    void set_shard(int index, int count);
+    bool empty() const { return rules.empty() && shard_count <= 1; }
+    // thread safe
+    bool match(const Context *ctx, IdString tile_type) const;
+
+  private:
+    struct Rule {
+        bool exclude = false;
+        bool is_regex = false;
+        std::string glob;
+        std::regex regex;
+        bool match(const std::string &s) const;
+    };
+    std::vector<Rule> rules;
+    bool has_include = false;
+    int shard_index = 0, shard_count = 1;
+    mutable std::vector<int8_t> verdicts; // by IdString index: 1 selected, 0 rejected, -1 not yet known
+    mutable std::shared_mutex mutex;
+    bool evaluate(const std::string &tile_type) const;
+};
+
+MEOW_NAMESPACE_END
+
+#endif
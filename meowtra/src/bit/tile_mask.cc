@@ -0,0 +1,77 @@
+#include "tile_mask.h"
+#include "context.h"
+#include "log.h"
+
+MEOW_NAMESPACE_BEGIN
+
+namespace {
+
+const char *builtin_masks[][2] = {
+    // exclude the DRP part of CMT tiles (PLL stuff)
+    {"EXCL_CMT_DRP", "CMT_L exclude 0_0-3_2879"},
+};
+
+}
+
+void TileMasks::parse(Context *ctx, line_range lines) {
+    for (auto line : lines) {
+        auto i = line.begin();
+        if (i == line.end())
+            continue;
+        auto &tt_rules = rules[ctx->id(std::string(*i++))];
+        if (i == line.end())
+            log_error("expected include or exclude after tile type in mask file\n");
+        auto mode = *i++;
+        if (mode != "include" && mode != "exclude")
+            log_error("unknown mask mode '%s'\n", std::string(mode).c_str());
+        auto &ranges = (mode == "include") ? tt_rules.include : tt_rules.exclude;
+        for (; i != line.end(); ++i) {
+            auto word = *i;
+            auto dash = word.find('-');
+            auto start = word.substr(0, dash), end = (dash == std::string_view::npos) ? word : word.substr(dash + 1);
+            auto [start_frame, start_bit] = split_view(start, '_');
+            auto [end_frame, end_bit] = split_view(end, '_');
+            ranges.push_back(BitRange{parse_i32(start_frame), parse_i32(start_bit), parse_i32(end_frame), parse_i32(end_bit)});
+        }
+    }
+}
+
+void TileMasks::add_builtin(Context *ctx, const std::string &name) {
+    for (auto &builtin : builtin_masks) {
+        if (name == builtin[0]) {
+            std::string buf(builtin[1]);
+            parse(ctx, lines(buf));
+            return;
+        }
+    }
+    log_error("unknown built-in filter '%s'\n", name.c_str());
+}
+
+void TileMasks::apply(TileData &tile) {
+    const BitVector *mask;
+    {
+        // hashlib lookups can rehash, so even finding the rules must be done under the lock
+        std::unique_lock lock(mutex);
+        auto found_rules = rules.find(tile.tile_type);
+        if (found_rules == rules.end())
+            return;
+        auto &m = masks[std::make_pair(tile.tile_type, tile.set_bits.size())];
+        if (!m) {
+            auto &tt_rules = found_rules->second;
+            m = std::make_unique<BitVector>(tile.set_bits.size(), tt_rules.include.empty());
+            auto set_range = [&](const BitRange &r, bool value) {
+                index_t start = r.start_frame * tile.bits + r.start_bit, end = r.end_frame * tile.bits + r.end_bit;
+                for (index_t b = std::max<index_t>(0, start); b <= std::min<index_t>(end, m->size() - 1); b++)
+                    m->set(b, value);
+            };
+            for (auto &r : tt_rules.include)
+                set_range(r, true);
+            for (auto &r : tt_rules.exclude)
+                set_range(r, false);
+        }
+        mask = m.get();
+    }
+    tile.set_bits &= *mask;
+}
+
+MEOW_NAMESPACE_END
@@ -0,0 +1,46 @@
+#ifndef TILE_MASK_H
+#define TILE_MASK_H
+
+#include "preface.h"
+#include "idstring.h"
+#include "hashlib.h"
+#include "bitvector.h"
+#include "datafile.h"
+#include "tile.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+MEOW_NAMESPACE_BEGIN
+
+struct Context;
+
+// Per tile type bit masks, applied to tiles with a bitwise AND. Mask files have lines of
+//     TILE_TYPE include|exclude frame_bit[-frame_bit] ...
+// where ranges are inclusive and in tile bit order. A tile type with any include ranges starts with everything
+// masked out; excludes are applied after includes.
+struct TileMasks {
+    // parses a mask file, or one of the built-in masks (e.g. EXCL_CMT_DRP) by name
+    void parse(Context *ctx, line_range lines);
+    void add_builtin(Context *ctx, const std::string &name);
+    bool empty() const { return rules.empty(); }
+    // thread safe
+    void apply(TileData &tile);
+
+    struct BitRange {
+        index_t start_frame, start_bit, end_frame, end_bit;
+    };
+    struct Rules {
+        std::vector<BitRange> include, exclude;
+    };
+    dict<IdString, Rules> rules;
+    // compiled masks, by tile type and size; boxed so they can be used without holding the lock
+    dict<std::pair<IdString, index_t>, std::unique_ptr<BitVector>> masks;
+    std::mutex mutex;
+};
+
+MEOW_NAMESPACE_END
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef BITVECTOR_H
+#define BITVECTOR_H
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include "preface.h"
+#include "hashlib.h"
+
+MEOW_NAMESPACE_BEGIN
+
+// A fixed size, densely packed bit vector; all the binary operations require both sides to be the same size
+struct BitVector {
+    std::vector<uint64_t> words;
+    index_t m_size = 0;
+
+    BitVector() = default;
+    explicit BitVector(index_t size, bool value = false) : words((size + 63) / 64, value ? ~uint64_t(0) : 0), m_size(size) {
+        clear_tail();
+    }
+
+    index_t size() const { return m_size; }
+    // grow or shrink, new bits are cleared
+    void resize(index_t size) {
+        m_size = size;
+        words.resize((size + 63) / 64, 0);
+        clear_tail();
+    }
+
+    bool get(index_t i) const { return (words[i / 64] >> (i % 64)) & 0x1; }
+    void set(index_t i, bool value = true) {
+        if (value)
+            words[i / 64] |= (uint64_t(1) << (i % 64));
+        else
+            words[i / 64] &= ~(uint64_t(1) << (i % 64));
+    }
+    void fill(bool value) {
+        std::fill(words.begin(), words.end(), value ? ~uint64_t(0) : 0);
+        clear_tail();
+    }
+
+    index_t count() const {
+        index_t result = 0;
+        for (auto w : words)
+            result += std::popcount(w);
+        return result;
+    }
+    bool any() const {
+        for (auto w : words)
+            if (w)
+                return true;
+        return false;
+    }
+    bool none() const { return !any(); }
+    bool intersects(const BitVector &other) const {
+        MEOW_ASSERT(m_size == other.m_size);
+        for (size_t i = 0; i < words.size(); i++)
+            if (words[i] & other.words[i])
+                return true;
+        return false;
+    }
+    // true if every bit set in other is also set here
+    bool contains(const BitVector &other) const {
+        MEOW_ASSERT(m_size == other.m_size);
+        for (size_t i = 0; i < words.size(); i++)
+            if ((words[i] & other.words[i]) != other.words[i])
+                return false;
+        return true;
+    }
+
+    BitVector &operator&=(const BitVector &other) {
+        MEOW_ASSERT(m_size == other.m_size);
+        for (size_t i = 0; i < words.size(); i++)
+            words[i] &= other.words[i];
+        return *this;
+    }
+    BitVector &operator|=(const BitVector &other) {
+        MEOW_ASSERT(m_size == other.m_size);
+        for (size_t i = 0; i < words.size(); i++)
+            words[i] |= other.words[i];
+        return *this;
+    }
+    BitVector &operator^=(const BitVector &other) {
+        MEOW_ASSERT(m_size == other.m_size);
+        for (size_t i = 0; i < words.size(); i++)
+            words[i] ^= other.words[i];
+        return *this;
+    }
+    // clear all bits that are set in other
+    BitVector &and_not(const BitVector &other) {
+        MEOW_ASSERT(m_size == other.m_size);
+        for (size_t i = 0; i < words.size(); i++)
+            words[i] &= ~other.words[i];
+        return *this;
+    }
+
+    bool operator==(const BitVector &other) const { return m_size == other.m_size && words == other.words; }
+    bool operator!=(const BitVector &other) const { return !(*this == other); }
+    unsigned hash() const {
+        unsigned h = mkhash_init;
+        for (auto w : words)
+            h = mkhash(h, mkhash(unsigned(w), unsigned(w >> 32)));
+        return h;
+    }
+
+    // iterates over the indices of set bits, in ascending order
+    struct const_iterator {
+        const BitVector *vec;
+        index_t word_idx;
+        uint64_t rest;
+        const_iterator(const BitVector *vec, index_t word_idx) : vec(vec), word_idx(word_idx), rest(0) {
+            if (word_idx < index_t(vec->words.size()))
+                rest = vec->words[word_idx];
+            skip();
+        }
+        void skip() {
+            while (rest == 0 && word_idx < index_t(vec->words.size())) {
+                if (++word_idx < index_t(vec->words.size()))
+                    rest = vec->words[word_idx];
+            }
+        }
+        index_t operator*() const { return word_idx * 64 + std::countr_zero(rest); }
+        const_iterator &operator++() {
+            rest &= rest - 1;
+            skip();
+            return *this;
+        }
+        bool operator==(const const_iterator &other) const { return word_idx == other.word_idx && rest == other.rest; }
+        bool operator!=(const const_iterator &other) const { return !(*this == other); }
+    };
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, index_t(words.size())); }
+
+  private:
+    void clear_tail() {
+        if (m_size % 64)
+            words.back() &= (uint64_t(1) << (m_size % 64)) - 1;
+    }
+};
+
+MEOW_NAMESPACE_END
+
+#endif
@@ -22,6 +22,7 @@ template <typename T> struct Chunk {
         ref_window subchunk(index_t offset, index_t len) const {
             return ref_window(base, this->offset + offset, len);
         }
+        const T *ptr() const { return base.base.data() + offset; }
     };
     struct fixed_zero {
         index_t m_size;
@@ -31,6 +32,7 @@ template <typename T> struct Chunk {
         fixed_zero subchunk(index_t offset, index_t len) const {
             return fixed_zero { len };
         }
+        inline const T *ptr() const { return nullptr; }
     };
     struct owned_data {
         std::vector<T> data;
@@ -40,6 +42,7 @@ template <typename T> struct Chunk {
         owned_data subchunk(index_t offset, index_t len) const {
             return owned_data { std::vector<T>(data.begin() + offset, data.begin() + offset + len) }; 
         }
+        inline const T *ptr() const { return data.data(); }
     };
     std::variant<owned_data, fixed_zero, ref_window> content;
     explicit Chunk(const std::vector<T> &data) : content(owned_data{data}) {};
@@ -61,6 +64,10 @@ template <typename T> struct Chunk {
     void set(index_t idx, T value) { 
         std::visit([&](auto &&x) { x.set(idx, value); }, content);
     }
+    // contiguous storage for fast bulk access, or nullptr if the chunk is all zeros
+    const T *ptr() const {
+        return std::visit([] (auto &&x) -> const T* { return x.ptr(); }, content);
+    }
     Chunk subchunk(index_t offset, index_t len) const {
         return std::visit([&] (auto &&x) -> Chunk<T> { return Chunk(x.subchunk(offset, len)); }, content);
     }
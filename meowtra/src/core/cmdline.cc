@@ -17,6 +17,10 @@ void CmdlineParser::add_positional(const std::string &name, bool optional, const
     pos_opts.emplace_back(name, optional, help);
 }
 
+void CmdlineParser::add_positional_list(const std::string &name, const std::string &help) {
+    pos_list = std::make_pair(name, help);
+}
+
 void CmdlineParser::print_help(const char *argv[], int arg_offset, std::ostream &out) {
     out << "Usage:";
     for (int i = 0; i < arg_offset; i++)
@@ -26,12 +30,15 @@ void CmdlineParser::print_help(const char *argv[], int arg_offset, std::ostream
         (void)help; // unused
         out << " " << (optional ? '[' : '<') << name << (optional ? ']' : '>');
     }
+    if (!pos_list.first.empty())
+        out << " [" << pos_list.first << "...]";
     out << std::endl << std::endl;
     int max_len = 5; // -help
     for (auto n : named_opts)
         max_len = std::max(max_len, int(n.first.size()) + 1);
     for (auto p : pos_opts)
         max_len = std::max(max_len, int(std::get<0>(p).size()) + 2);
+    max_len = std::max(max_len, int(pos_list.first.size()) + 5);
 
     out << "Options: " << std::endl;
     write_rpad(out, "-help", max_len + 4);
@@ -49,6 +56,10 @@ void CmdlineParser::print_help(const char *argv[], int arg_offset, std::ostream
         write_rpad(out, field, max_len + 4);
         out << help << std::endl;
     }
+    if (!pos_list.first.empty()) {
+        write_rpad(out, "[" + pos_list.first + "...]", max_len + 4);
+        out << pos_list.second << std::endl;
+    }
     out << std::endl;
 }
 
@@ -95,6 +106,10 @@ bool CmdlineParser::parse(int argc, const char *argv[], int arg_offset, std::ost
         }
         result.positional.emplace_back(argv[cursor++]);
     }
+    if (!pos_list.first.empty()) {
+        while (cursor < argc)
+            result.positional.emplace_back(argv[cursor++]);
+    }
     return true;
 }
 
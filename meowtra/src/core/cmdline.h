@@ -17,9 +17,11 @@ struct CmdlineResult {
 struct CmdlineParser {
     std::unordered_map<std::string, std::pair<int, std::string>> named_opts;
     std::vector<std::tuple<std::string, bool, std::string>> pos_opts;
+    std::pair<std::string, std::string> pos_list; // name, help; for any trailing positionals
 
     void add_opt(const std::string &name, int arg_count, const std::string &help);
     void add_positional(const std::string &name, bool optional, const std::string &help);
+    void add_positional_list(const std::string &name, const std::string &help);
 
     void print_help(const char *argv[], int arg_offset, std::ostream &out);
 
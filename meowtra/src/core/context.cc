@@ -1,5 +1,6 @@
 #include "context.h"
 #include "constids.h"
+#include "database.h"
 
 MEOW_NAMESPACE_BEGIN
 
@@ -12,4 +13,6 @@ Context::Context() {
 #undef X
 }
 
+Context::~Context() {}
+
 MEOW_NAMESPACE_END
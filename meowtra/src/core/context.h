@@ -5,19 +5,28 @@
 #include <unordered_map>
 #include <vector>
 #include <shared_mutex>
+#include <mutex>
+#include <memory>
 
 #include "preface.h"
 #include "idstring.h"
 
 MEOW_NAMESPACE_BEGIN
 
+struct Device;
+struct DeviceDatabase;
+
 struct Context {
     // ID String database.
     Context();
+    ~Context();
     mutable std::unordered_map<std::string, int> *idstring_str_to_idx;
     mutable std::vector<const std::string *> *idstring_idx_to_str;
     mutable std::shared_mutex idstring_mutex;
     IdString id(const std::string &s) { return IdString(this, s); };
+    // Loaded device databases, see get_device_db
+    std::unordered_map<const Device *, std::unique_ptr<DeviceDatabase>> device_dbs;
+    std::mutex device_db_mutex;
 };
 
 MEOW_NAMESPACE_END
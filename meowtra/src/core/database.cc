@@ -2,11 +2,15 @@
 #include "database.h"
 #include "datafile.h"
 #include "log.h"
+#include "constids.h"
 
+#include <algorithm>
 #include <iterator>
 #include <fstream>
 #include <filesystem>
 #include <vector>
+#include <memory>
+#include <mutex>
 
 // From Yosys
 #if defined(_WIN32)
@@ -196,4 +200,195 @@ std::vector<TileRegion> get_tile_regions(Context *ctx, const Device &dev) {
     return result;
 }
 
+dict<IdString, BitVector> get_tile_defaults(Context *ctx, const Device &dev, const std::vector<TileRegion> &regions) {
+    dict<IdString, BitVector> result;
+    dict<IdString, index_t> frame_bits;
+    for (const auto &r : regions) {
+        if (result.count(r.prefix))
+            continue;
+        result[r.prefix] = BitVector(r.tile_frames * r.tile_height * 48);
+        frame_bits[r.prefix] = r.tile_height * 48;
+    }
+    auto set_default = [&](IdString tile_type, index_t frame, index_t bit) {
+        if (!result.count(tile_type))
+            return; // not on this device
+        result.at(tile_type).set(frame * frame_bits.at(tile_type) + bit);
+    };
+    std::ifstream in(stringf("%s/%s/%s/tile_defaults.txt", get_db_root().c_str(), dev.family.c_str(), dev.name.c_str()));
+    if (in) {
+        std::string buf(std::istreambuf_iterator<char>(in), {});
+        for (auto line : lines(buf)) {
+            auto i = line.begin();
+            if (i == line.end())
+                continue;
+            IdString tile_type = ctx->id(std::string(*i++));
+            for (; i != line.end(); ++i) {
+                auto [frame, bit] = split_view(*i, '_');
+                set_default(tile_type, parse_i32(frame), parse_i32(bit));
+            }
+        }
+    } else {
+        // fallback for logic tiles only: 0_8, 0_16, 0_24, 0_32, 0_40; 4_0, 4_8, 4_16, 4_24, 4_32, 4_40, 8_0, 8_8, 8_32, 8_40
+        static const std::vector<index_t> empty_logic_tile = {0, 8, 16, 24, 32, 40, 192, 200, 208, 216, 224, 232, 384, 392, 416, 424};
+        for (IdString tile_type : {id_CLEL_L, id_CLEL_R, id_CLEM, id_CLEM_R})
+            for (index_t bit : empty_logic_tile)
+                set_default(tile_type, bit / 48, bit % 48);
+    }
+    return result;
+}
+
+void SiteSplitTable::compile(Context *ctx, const TileRegion &region) {
+    index_t frame_bits = region.tile_height * 48, num_bits = region.tile_frames * frame_bits;
+    // counting pass then fill, so each tile bit's targets are contiguous
+    std::vector<index_t> count(num_bits + 1, 0);
+    auto for_each_bit = [&](auto func) {
+        for (index_t i = 0; i < index_t(sites.size()); i++) {
+            auto &s = sites.at(i);
+            for (index_t f = 0; f < s.frames; f++) {
+                for (index_t w = 0; w < s.words; w++) {
+                    for (index_t b = 0; b < 48; b++) {
+                        index_t tile_bit = (s.start_frame + f) * frame_bits + (s.start_word + w) * 48 + b;
+                        if (tile_bit < num_bits)
+                            func(tile_bit, i, f * s.words * 48 + w * 48 + b);
+                    }
+                }
+            }
+        }
+    };
+    for_each_bit([&](index_t tile_bit, index_t, index_t) { ++count.at(tile_bit + 1); });
+    bit_start.assign(num_bits + 1, 0);
+    for (index_t b = 0; b < num_bits; b++)
+        bit_start.at(b + 1) = bit_start.at(b) + count.at(b + 1);
+    site_bits.resize(bit_start.back());
+    std::vector<index_t> next(bit_start.begin(), bit_start.end() - 1);
+    for_each_bit([&](index_t tile_bit, index_t site, index_t site_bit) {
+        site_bits.at(next.at(tile_bit)++) = std::make_pair(site, site_bit);
+    });
+    prefix_site.clear();
+    dict<IdString, std::pair<index_t, index_t>> site_type_size;
+    for (index_t i = 0; i < index_t(sites.size()); i++) {
+        auto &s = sites.at(i);
+        auto size = std::make_pair(s.frames, s.words);
+        if (site_type_size.count(s.site_type) && site_type_size.at(s.site_type) != size)
+            log_error("sites of type %s in %s have different sizes\n", s.site_type.c_str(ctx), region.prefix.c_str(ctx));
+        site_type_size[s.site_type] = size;
+        prefix_site[stringf("%s_X%dY%d", s.site_type.c_str(ctx), s.dx, s.dy)] = i;
+    }
+}
+
+dict<IdString, SiteSplitTable> get_site_splits(Context *ctx, const Device &dev, const std::vector<TileRegion> &regions) {
+    dict<IdString, SiteSplitTable> result;
+    std::ifstream in(stringf("%s/%s/%s/site_splits.txt", get_db_root().c_str(), dev.family.c_str(), dev.name.c_str()));
+    if (in) {
+        // tile_type site_type dx dy start_frame frames start_word words
+        std::string buf(std::istreambuf_iterator<char>(in), {});
+        for (auto line : lines(buf)) {
+            auto i = line.begin();
+            if (i == line.end())
+                continue;
+            auto &table = result[ctx->id(std::string(*i++))];
+            SiteSplit s;
+            s.site_type = ctx->id(std::string(*i++));
+            s.dx = parse_i32(*i++);
+            s.dy = parse_i32(*i++);
+            s.start_frame = parse_i32(*i++);
+            s.frames = parse_i32(*i++);
+            s.start_word = parse_i32(*i++);
+            s.words = parse_i32(*i++);
+            table.sites.push_back(s);
+        }
+    } else {
+        // fallback: the HPIO_L layout
+        auto &table = result[id_HPIO_L];
+        for (int y = 0; y <= 25; y++) {
+            if (y == 12 || y == 25) {
+                table.sites.push_back(SiteSplit{id_HPIOB_SNGL, 0, int16_t(y), (y == 12) ? 2 : 0, 2, 16, 2});
+            } else {
+                int bit_y = (y >= 12) ? (y + 3) : y;
+                IdString site_type = (y % 2) == ((y < 12) ? 0 : 1) ? id_HPIOB_M : id_HPIOB_S;
+                table.sites.push_back(SiteSplit{site_type, 0, int16_t(y), ((bit_y % 4) < 2) ? 2 : 0, 2, 2 + 2 * (2 * (bit_y / 4) + (bit_y % 2)), 2});
+            }
+        }
+    }
+    // compile the tables for the tile types on this device, with their geometry
+    dict<IdString, SiteSplitTable> compiled;
+    for (const auto &r : regions) {
+        if (!result.count(r.prefix) || compiled.count(r.prefix))
+            continue;
+        auto &table = compiled[r.prefix];
+        table = std::move(result.at(r.prefix));
+        table.compile(ctx, r);
+    }
+    return compiled;
+}
+
+namespace {
+// bit offset within a frame with the ECC bits removed
+index_t logical_frame_bit(index_t frame_bit) {
+    return (frame_bit >= 1488) ? (frame_bit - 48) : frame_bit;
+}
+}
+
+void TileBitIndex::build(const std::vector<TileRegion> &regions) {
+    dict<std::pair<uint32_t, uint32_t>, std::array<index_t, frame_rows>> frame_rows_map;
+    for (index_t i = 0; i < index_t(regions.size()); i++) {
+        auto &r = regions.at(i);
+        index_t row0 = logical_frame_bit(r.start_bit) / 48;
+        for (uint32_t f = 0; f < r.tile_frames; f++) {
+            auto key = std::make_pair(uint32_t(r.slr), r.start_frame + f);
+            if (!frame_rows_map.count(key))
+                frame_rows_map[key].fill(-1);
+            auto &rows = frame_rows_map.at(key);
+            for (index_t row = row0; row < std::min<index_t>(frame_rows, row0 + r.num_tiles * r.tile_height); row++)
+                rows[row] = i;
+        }
+    }
+    dict<std::vector<index_t>, index_t> unique_layouts;
+    for (auto &entry : frame_rows_map) {
+        std::vector<index_t> rows(entry.second.begin(), entry.second.end());
+        auto found = unique_layouts.find(rows);
+        if (found == unique_layouts.end()) {
+            found = unique_layouts.emplace(rows, index_t(layouts.size())).first;
+            layouts.push_back(entry.second);
+        }
+        frame_layout[entry.first] = found->second;
+    }
+}
+
+bool TileBitIndex::lookup(const std::vector<TileRegion> &regions, uint32_t slr, uint32_t frame, index_t frame_bit, TileBitLocation &loc) const {
+    if (frame_bit >= 1440 && frame_bit < 1488)
+        return false; // ECC
+    auto found = frame_layout.find(std::make_pair(slr, frame));
+    if (found == frame_layout.end())
+        return false;
+    index_t lbit = logical_frame_bit(frame_bit);
+    if (lbit >= frame_rows * 48)
+        return false;
+    index_t ri = layouts.at(found->second)[lbit / 48];
+    if (ri == -1)
+        return false;
+    auto &r = regions.at(ri);
+    index_t tile_size = r.tile_height * 48;
+    index_t offset = lbit - logical_frame_bit(r.start_bit);
+    loc.region = ri;
+    loc.tile = offset / tile_size;
+    loc.bit = (frame - r.start_frame) * tile_size + (offset % tile_size);
+    return true;
+}
+
+const DeviceDatabase &get_device_db(Context *ctx, const Device &dev) {
+    std::unique_lock lock(ctx->device_db_mutex);
+    auto &entry = ctx->device_dbs[&dev];
+    if (!entry) {
+        entry = std::make_unique<DeviceDatabase>();
+        entry->dev = &dev;
+        entry->frame_ranges = get_device_frames(dev);
+        entry->tile_regions = get_tile_regions(ctx, dev);
+        entry->bit_index.build(entry->tile_regions);
+        entry->tile_defaults = get_tile_defaults(ctx, dev, entry->tile_regions);
+        entry->site_splits = get_site_splits(ctx, dev, entry->tile_regions);
+    }
+    return *entry;
+}
+
 MEOW_NAMESPACE_END
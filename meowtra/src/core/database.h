@@ -1,11 +1,15 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
+#include <array>
 #include <string>
 #include <vector>
 
 #include "preface.h"
 #include "idstring.h"
+#include "hashlib.h"
+#include "tile_key.h"
+#include "bitvector.h"
 
 MEOW_NAMESPACE_BEGIN
 
@@ -46,10 +50,70 @@ struct TileRegion {
     uint16_t tile_height;
     uint16_t tile_frames;
     uint16_t num_tiles;
+
+    TileKey tile_key(index_t i) const { return TileKey{.prefix=prefix, .x=tile_x, .y=int16_t(tile_y0 + i)}; }
 };
 
 std::vector<TileRegion> get_tile_regions(Context *ctx, const Device &dev);
 
+// Where a frame bit ends up
+struct TileBitLocation {
+    index_t region = -1; // index into tile_regions
+    index_t tile = -1; // tile index inside the region
+    index_t bit = -1; // tile-local bit index
+};
+
+// Reverse (frame, bit) -> tile index
+struct TileBitIndex {
+    static constexpr int frame_rows = 61; // 48-bit rows per frame, not counting ECC
+    // Covering region for each row of a frame; frames with the same set of regions share a layout
+    std::vector<std::array<index_t, frame_rows>> layouts;
+    dict<std::pair<uint32_t, uint32_t>, index_t> frame_layout; // (slr, frame address) -> layout
+
+    void build(const std::vector<TileRegion> &regions);
+    // returns false for ECC bits and bits outside any tile
+    bool lookup(const std::vector<TileRegion> &regions, uint32_t slr, uint32_t frame, index_t frame_bit, TileBitLocation &loc) const;
+};
+
+// The set bits of an unconfigured tile for each tile type, read from tile_defaults.txt where available
+dict<IdString, BitVector> get_tile_defaults(Context *ctx, const Device &dev, const std::vector<TileRegion> &regions);
+
+// A site inside a tile, covering a window of frames and 48-bit words of the tile
+struct SiteSplit {
+    IdString site_type;
+    int16_t dx, dy; // site features are named SITE_TYPE_X<dx>Y<dy>.FEATURE in the tile
+    index_t start_frame, frames;
+    index_t start_word, words;
+};
+
+// Site splits of one tile type, compiled into a tile bit -> site bit map and a feature prefix index
+struct SiteSplitTable {
+    std::vector<SiteSplit> sites;
+    // tile bit b maps to site_bits[bit_start[b]..bit_start[b+1]), as (site index, site bit)
+    std::vector<index_t> bit_start;
+    std::vector<std::pair<index_t, index_t>> site_bits;
+    dict<std::string, index_t> prefix_site; // "SITE_TYPE_X<dx>Y<dy>" -> site index
+
+    void compile(Context *ctx, const TileRegion &region);
+    // bits in each frame of a site
+    index_t site_frame_bits(index_t site) const { return sites.at(site).words * 48; }
+};
+
+// Site splits for tile types, read from site_splits.txt where available, with a built-in HPIO_L table otherwise
+dict<IdString, SiteSplitTable> get_site_splits(Context *ctx, const Device &dev, const std::vector<TileRegion> &regions);
+
+// Everything loaded from the database for one device; loaded once per Context and shared between threads
+struct DeviceDatabase {
+    const Device *dev = nullptr;
+    std::vector<FrameRange> frame_ranges;
+    std::vector<TileRegion> tile_regions;
+    TileBitIndex bit_index;
+    dict<IdString, BitVector> tile_defaults;
+    dict<IdString, SiteSplitTable> site_splits;
+};
+
+const DeviceDatabase &get_device_db(Context *ctx, const Device &dev);
+
 MEOW_NAMESPACE_END
 
 #endif
@@ -0,0 +1,52 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "preface.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+MEOW_NAMESPACE_BEGIN
+
+// Number of worker threads to use if not otherwise specified
+inline int default_thread_count() {
+    unsigned n = std::thread::hardware_concurrency();
+    return (n == 0) ? 1 : int(n);
+}
+
+// Parse a -j style thread count, where 0 or empty means the default
+inline int parse_thread_count(const std::string &s) {
+    int n = s.empty() ? 0 : std::stoi(s);
+    return (n <= 0) ? default_thread_count() : n;
+}
+
+// Calls func(i) for i in [0, count) on a bounded pool of worker threads that pull indices from a shared counter
+template <typename Tfunc> void parallel_for(index_t count, int threads, Tfunc func) {
+    threads = std::max(1, std::min(threads, int(count)));
+    std::atomic<index_t> next(0);
+    auto worker = [&]() {
+        while (true) {
+            index_t i = next++;
+            if (i >= count)
+                break;
+            func(i);
+        }
+    };
+    if (threads == 1) {
+        worker();
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (int i = 0; i < threads; i++)
+        workers.emplace_back(worker);
+    for (auto &th : workers)
+        th.join();
+}
+
+MEOW_NAMESPACE_END
+
+#endif
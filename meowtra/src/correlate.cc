@@ -5,13 +5,23 @@
 #include "cmdline.h"
 #include "log.h"
 #include "database.h"
-#include "constids.h"
 #include "feature.h"
 #include "specimen.h"
 #include "split_sites.h"
+#include "parallel.h"
+#include "spec_cache.h"
+#include "segbits.h"
+#include "tile_mask.h"
+#include "tile_filter.h"
 
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <algorithm>
 #include <fstream>
-#include <thread>
+#include <sstream>
 #include <vector>
 #include <filesystem>
 
@@ -34,157 +44,460 @@ struct CorrelateWorker {
                 continue;
             file_prefices.push_back(spec_dir / base);
         }
+        // directory order is arbitrary; sorting makes specimen ranges and tie breaks the same on every machine
+        std::sort(file_prefices.begin(), file_prefices.end());
+        if (args.named.count("specimens")) {
+            // inclusive range of indices into the sorted specimen list, or a single index
+            const std::string &range = args.named.at("specimens").at(0);
+            std::string_view range_view(range);
+            auto dash = range_view.find('-');
+            auto first_str = range_view.substr(0, dash);
+            auto last_str = (dash == std::string_view::npos) ? first_str : range_view.substr(dash + 1);
+            auto parse_index = [&](std::string_view s) {
+                index_t value = -1;
+                auto [end, err] = std::from_chars(s.data(), s.data() + s.size(), value);
+                if (err != std::errc() || end != s.data() + s.size() || value < 0)
+                    log_error("bad specimen range '%s', expected N, N-M or N-\n", range.c_str());
+                return value;
+            };
+            index_t first = parse_index(first_str);
+            index_t last = last_str.empty() ? index_t(file_prefices.size()) - 1 : parse_index(last_str);
+            last = std::min<index_t>(last, index_t(file_prefices.size()) - 1);
+            if (first < 0 || first > last)
+                log_error("empty specimen range '%s'\n", range.c_str());
+            file_prefices = std::vector<std::string>(file_prefices.begin() + first, file_prefices.begin() + last + 1);
+        }
     }
 
     void worker(index_t i) {
-        std::ifstream in_bit(file_prefices.at(i) + ".bit", std::ios::binary);
-        auto bit = RawBitstream::read(in_bit);
-        auto packets = bit.packetise();
-        auto frames = packets_to_frames(packets);
-        tile_bits.at(i) = frames_to_tiles(&ctx, frames);
-        std::ifstream in_feat(file_prefices.at(i) + ".features");
-        std::string feat_buf(std::istreambuf_iterator<char>(in_feat), {});
-        tile_feats.at(i) = TileFeatures::parse(&ctx, lines(feat_buf));
+        {
+            // don't get more than commit_window specimens ahead of the oldest one not yet committed, so a slow
+            // specimen can't leave every later one sitting fully loaded in pending
+            std::unique_lock lock(commit_mutex);
+            commit_cv.wait(lock, [&]() { return i < next_commit + commit_window; });
+        }
+        const std::string &prefix = file_prefices.at(i);
+        TileGrid grid;
+        TileFeatures feats;
+        if (use_cache && read_specimen_cache(&ctx, prefix, grid, feats)) {
+            ++cache_hits;
+        } else {
+            std::ifstream in_bit(prefix + ".bit", std::ios::binary);
+            auto bit = RawBitstream::read(in_bit);
+            auto packets = bit.packetise();
+            auto frames = packets_to_frames(&ctx, packets);
+            // the cache stores the unfiltered grid, so it stays valid for any -tiles/-filter; otherwise unselected
+            // tile types are never decoded
+            const TileTypeFilter *filter = use_cache ? nullptr : &tile_filter;
+            grid = frames_to_tiles(&ctx, frames, filter);
+            std::ifstream in_feat(prefix + ".features");
+            std::string feat_buf(std::istreambuf_iterator<char>(in_feat), {});
+            feats = TileFeatures::parse(&ctx, lines(feat_buf), filter);
+            if (use_cache)
+                write_specimen_cache(&ctx, prefix, grid, feats);
+        }
+        filter_grid(grid);
+        if (grid.dev) {
+            const DeviceDatabase *db = &get_device_db(&ctx, *grid.dev), *expected = nullptr;
+            if (!device_db.compare_exchange_strong(expected, db) && expected != db)
+                log_error("specimens are for different devices\n");
+        }
+        // add to the groups and accumulators in specimen order, so the results don't depend on thread timing; each
+        // specimen is freed as soon as it has been added
+        std::unique_lock lock(commit_mutex);
+        pending.at(i) = std::make_unique<LoadedSpecimen>(LoadedSpecimen{std::move(grid), std::move(feats)});
+        if (committing)
+            return; // the committing thread picks it up once it gets there
+        // this thread commits every specimen that is ready; the adding itself is done without holding the lock, so
+        // other loaders can keep handing over specimens
+        committing = true;
+        while (next_commit < index_t(pending.size()) && pending.at(next_commit)) {
+            auto spec = std::move(pending.at(next_commit));
+            index_t committed = next_commit + 1;
+            lock.unlock();
+            if (streaming || convergence_out)
+                accumulate(spec->bits, spec->feats);
+            if (!streaming)
+                bucket_specimen(spec->bits, spec->feats);
+            spec.reset();
+            // so each row covers exactly the first committed specimens
+            if (convergence_out && ((committed % convergence_step) == 0 || committed == index_t(pending.size())))
+                write_convergence(committed);
+            lock.lock();
+            next_commit = committed;
+            commit_cv.notify_all();
+        }
+        committing = false;
     }
 
-    void parse_files() {
-        log_info("loading %d bitstream+feature pairs...\n", int(file_prefices.size()));
-        tile_bits.resize(file_prefices.size());
-        tile_feats.resize(file_prefices.size());
-        std::vector<std::thread> threads;
-        threads.reserve(file_prefices.size());
-        for (index_t i = 0; i < index_t(file_prefices.size()); i++)
-            threads.emplace_back([this, i]() { this->worker(i); });
-        for (auto &th : threads)
-            th.join();
-    }
-
-    void filter_tiles() {
-        std::vector<std::string_view> tile_rules;
-        if (args.named.count("tiles")) {
-            std::string_view tr(args.named.at("tiles").at(0));
-            while(true) {
-                size_t pos = tr.find(',');
-                if (pos == std::string_view::npos) {
-                    tile_rules.push_back(tr);
-                    break;
-                } else {
-                    tile_rules.push_back(tr.substr(0, pos));
-                    tr = tr.substr(pos + 1);
-                }
-            }
+    SpecimenAccumulator &get_accumulator(AccumulatorKey group, int group_tile_bits) {
+        std::unique_lock lock(accumulator_mutex);
+        auto &acc = accumulators[group];
+        if (!acc) {
+            acc = std::make_unique<SpecimenAccumulator>();
+            acc->tile_bits = group_tile_bits;
+            acc->min_count = min_count;
+            acc->bus_aware = bus_aware;
+        } else if (acc->tile_bits != group_tile_bits) {
+            log_error("%s has %d bits per frame, but %d before\n", group.str(&ctx).c_str(), group_tile_bits, acc->tile_bits);
         }
-        pool<IdString> all_tiletypes;
-        for (const auto &fs : tile_feats) {
-            for (const auto &entry : fs.tiles) {
-                all_tiletypes.insert(entry.first.prefix);
+        return *acc;
+    }
+
+    void accumulate(const TileGrid &bits, const TileFeatures &feats) {
+        for (auto &feat_tile : feats.tiles) {
+            IdString tt = feat_tile.first.prefix;
+            if (!tile_filter.match(&ctx, tt))
+                continue;
+            auto bit_tile = bits.get(feat_tile.first);
+            if (!bit_tile)
+                continue;
+            if (args.named.count("sites")) {
+                auto table = site_split_table(tt);
+                if (!table)
+                    continue;
+                for (auto &s : split_sites(&ctx, *table, bit_tile->set_bits, feat_tile.second))
+                    get_accumulator(AccumulatorKey{tt, s.site_type}, s.frame_bits).add(s.set_features, s.set_bits);
+            } else {
+                get_accumulator(AccumulatorKey{tt, IdString()}, bit_tile->bits).add(feat_tile.second, bit_tile->set_bits);
             }
         }
-        if (tile_rules.empty()) { // include everything
-            included_tiletypes = all_tiletypes;
-        } else {
-            for (auto tt : all_tiletypes) {
-                const std::string &tt_str = tt.str(&ctx);
-                for (auto rule : tile_rules) {
-                    if (rule == tt_str) {
-                        included_tiletypes.insert(tt);
-                    } else if (rule.at(rule.size() - 1) == '*' && rule.substr(0, rule.size() - 1) == tt_str.substr(0, rule.size() - 1)) {
-                        included_tiletypes.insert(tt);
-                    }
-                }
-            }
+    }
+
+    void solve_accumulators() {
+        // resolved up front: hashlib lookups can rehash, so the workers must not touch the dict
+        std::vector<std::pair<AccumulatorKey, SpecimenAccumulator*>> sorted_groups;
+        for (auto &acc : accumulators)
+            sorted_groups.emplace_back(acc.first, acc.second.get());
+        std::sort(sorted_groups.begin(), sorted_groups.end(), [&](const auto &a, const auto &b) {
+            return a.first.less(&ctx, b.first);
+        });
+        std::vector<std::string> results(sorted_groups.size());
+        parallel_for(index_t(sorted_groups.size()), threads, [&](index_t i) {
+            auto [group, acc] = sorted_groups.at(i);
+            log_info("processing %s (%d specimens)...\n", group.str(&ctx).c_str(), acc->num_specs);
+            std::ostringstream out;
+            out << "*** " << group.header().c_str(&ctx) << " ***" << std::endl;
+            acc->solve(&ctx, out);
+            results.at(i) = out.str();
+        });
+        write_results(results);
+    }
+
+    // partial results for mergeacc, in group name order
+    void write_partials(const std::string &filename) {
+        std::ofstream out(filename);
+        if (!out)
+            log_error("failed to open '%s' for writing\n", filename.c_str());
+        std::vector<AccumulatorKey> sorted_groups;
+        for (auto &acc : accumulators)
+            sorted_groups.push_back(acc.first);
+        std::sort(sorted_groups.begin(), sorted_groups.end(), [&](AccumulatorKey a, AccumulatorKey b) {
+            return a.less(&ctx, b);
+        });
+        for (auto group : sorted_groups)
+            accumulators.at(group)->write(&ctx, group, out);
+    }
+
+    void parse_min_count() {
+        if (!args.named.count("min-count"))
+            return;
+        min_count = parse_i32(args.named.at("min-count").at(0));
+        if (min_count < 1)
+            log_error("-min-count must be at least 1\n");
+    }
+
+    // combine partial results from correlate -partial runs, then solve them or write a further partial
+    void run_merge() {
+        threads = parse_thread_count(args.named.count("j") ? args.named.at("j").at(0) : "");
+        parse_min_count();
+        bus_aware = args.named.count("bus");
+        // merging is commutative, and solve order ties are broken by name, so the order given doesn't matter
+        for (auto &filename : args.positional) {
+            std::ifstream in(filename);
+            if (!in)
+                log_error("failed to open partial result '%s'\n", filename.c_str());
+            std::string buf(std::istreambuf_iterator<char>(in), {});
+            read_partials(&ctx, filename, lines(buf), accumulators);
+        }
+        for (auto &acc : accumulators) {
+            acc.second->min_count = min_count;
+            acc.second->bus_aware = bus_aware;
         }
+        if (args.named.count("partial"))
+            write_partials(args.named.at("partial").at(0));
+        else
+            solve_accumulators();
     }
 
-    void filter_bits(const std::string &mode) {
-        bool filter_cmt = (mode == "EXCL_CMT_DRP");
-        for (auto &des : tile_bits) {
-            for (auto &tile : des.tiles) {
-                // exclude the DRP part of CMT tiles (PLL stuff)
-                if (tile.first.prefix == id_CMT_L && filter_cmt) {
-                    for (int i = 0; i < (4*60*48); i++)
-                        tile.second.set_bits.erase(i);
-                }
+    // Appends one line per group with the current state of the first solve pass, so a fuzzer driver can stop once
+    // it stops changing. Columns: specimens group features pending solved ambiguous empty changed
+    //   pending: seen in fewer than min-count specimens
+    //   solved/ambiguous: non-empty candidate bits that are unique to the feature, or shared with another feature
+    //   changed: features whose candidate bits changed (or that are new) since the last summary
+    void write_convergence(index_t num_committed) {
+        std::unique_lock conv_lock(convergence_mutex);
+        std::vector<AccumulatorKey> sorted_groups;
+        {
+            std::unique_lock lock(accumulator_mutex);
+            for (auto &acc : accumulators)
+                sorted_groups.push_back(acc.first);
+        }
+        std::sort(sorted_groups.begin(), sorted_groups.end(), [&](AccumulatorKey a, AccumulatorKey b) {
+            return a.less(&ctx, b);
+        });
+        index_t total[6] = {0, 0, 0, 0, 0, 0};
+        for (auto group : sorted_groups) {
+            SpecimenAccumulator *acc;
+            {
+                std::unique_lock lock(accumulator_mutex);
+                acc = accumulators.at(group).get();
+            }
+            std::vector<Feature> to_solve;
+            std::vector<BitVector> result;
+            std::vector<index_t> dep_count;
+            {
+                std::unique_lock lock(acc->mutex);
+                acc->first_pass(&ctx, to_solve, result, dep_count);
             }
+            dict<BitVector, index_t> result_count;
+            for (auto &r : result)
+                if (r.any())
+                    ++result_count[r];
+            auto &prev = last_results[group];
+            index_t counts[6] = {index_t(result.size()), 0, 0, 0, 0, 0};
+            for (index_t f = 0; f < index_t(result.size()); f++) {
+                auto &r = result.at(f);
+                if (r.size() == 0)
+                    ++counts[1];
+                else if (r.none())
+                    ++counts[4];
+                else if (result_count.at(r) == 1)
+                    ++counts[2];
+                else
+                    ++counts[3];
+                if (f >= index_t(prev.size()) || prev.at(f) != r)
+                    ++counts[5];
+            }
+            prev = std::move(result);
+            *convergence_out << num_committed << " " << group.str(&ctx);
+            for (int i = 0; i < 6; i++) {
+                *convergence_out << " " << counts[i];
+                total[i] += counts[i];
+            }
+            *convergence_out << std::endl;
         }
+        *convergence_out << num_committed << " *";
+        for (int i = 0; i < 6; i++)
+            *convergence_out << " " << total[i];
+        *convergence_out << std::endl;
     }
 
-    void do_correlate(IdString tt) {
-        SpecimenGroup group;
-        for (index_t i = 0; i < index_t(tile_bits.size()); i++) {
-            auto &bits = tile_bits.at(i);
-            auto &feats = tile_feats.at(i);
-            for (auto &feat_tile : feats.tiles) {
-                if (feat_tile.first.prefix != tt)
-                    continue;
-                if (!bits.tiles.count(feat_tile.first))
+    void write_results(const std::vector<std::string> &results) {
+        for (auto &r : results)
+            std::cout << r;
+        if (!args.named.count("db"))
+            return;
+        // merge into the result database, replacing existing results seen in fewer specimens
+        const std::string &db_dir = args.named.at("db").at(0);
+        SegBits segbits, new_segbits;
+        if (std::filesystem::is_directory(db_dir))
+            segbits.read_db(&ctx, db_dir);
+        for (auto &r : results)
+            new_segbits.parse(&ctx, lines(r));
+        segbits.merge(&ctx, new_segbits);
+        segbits.write_db(&ctx, db_dir);
+    }
+
+    void parse_files() {
+        index_t count = index_t(file_prefices.size());
+        log_info("loading %d bitstream+feature pairs using %d threads...\n", count, threads);
+        pending.resize(count);
+        commit_window = std::max(2 * threads, 4);
+        std::atomic<index_t> loaded(0);
+        index_t report_step = std::max<index_t>(1, count / 20);
+        convergence_step = report_step;
+        parallel_for(count, threads, [&](index_t i) {
+            this->worker(i);
+            index_t done = ++loaded;
+            if ((done % report_step) == 0 || done == count)
+                log_info("    loaded %d/%d\n", done, count);
+        });
+        if (use_cache)
+            log_info("specimen cache: %d hits, %d misses\n", int(cache_hits), count - int(cache_hits));
+    }
+
+    // copy the (features, bits) of every included tile of a specimen into its group
+    void bucket_specimen(const TileGrid &bits, const TileFeatures &feats) {
+        bool sites = args.named.count("sites");
+        for (auto &feat_tile : feats.tiles) {
+            IdString tt = feat_tile.first.prefix;
+            if (!tile_filter.match(&ctx, tt))
+                continue;
+            auto bit_tile = bits.get(feat_tile.first);
+            if (!bit_tile)
+                continue;
+            if (sites) {
+                auto table = site_split_table(tt);
+                if (!table)
                     continue;
-                auto &bit_tile = bits.tiles.at(feat_tile.first);
-                group.tile_bits = bit_tile.bits;
-                group.specs.emplace_back(feat_tile.second, bit_tile.set_bits);
+                for (auto &s : split_sites(&ctx, *table, bit_tile->set_bits, feat_tile.second)) {
+                    auto &group = site_groups[tt][s.site_type];
+                    group.tile_bits = s.frame_bits;
+                    group.min_count = min_count;
+                    group.bus_aware = bus_aware;
+                    group.add(s.set_features, s.set_bits);
+                }
+            } else {
+                auto &group = groups[tt];
+                group.tile_bits = bit_tile->bits;
+                group.min_count = min_count;
+                group.bus_aware = bus_aware;
+                group.add(feat_tile.second, bit_tile->set_bits);
             }
         }
-        if (group.specs.empty())
+    }
+
+    void filter_grid(TileGrid &grid) {
+        if (masks.empty())
             return;
+        for (auto &tile : grid.tiles)
+            masks.apply(tile.second);
+        for (auto &tile : grid.defaults)
+            masks.apply(tile.second);
+    }
+
+    void do_correlate(IdString tt, SpecimenGroup &group, std::ostream &out) {
         log_info("processing tile type %s...\n", tt.c_str(&ctx));
-        std::cout << "*** " << tt.c_str(&ctx) << " ***" << std::endl;
+        out << "*** " << tt.c_str(&ctx) << " ***" << std::endl;
         group.find_deps();
-        group.solve(&ctx);
+        group.solve(&ctx, out);
     }
 
-    void do_site_correlate(IdString tt) {
-        std::vector<SplitSite> sites;
-        pool<IdString> site_types;
-        for (index_t i = 0; i < index_t(tile_bits.size()); i++) {
-            auto &bits = tile_bits.at(i);
-            auto &feats = tile_feats.at(i);
-            for (auto &feat_tile : feats.tiles) {
-                if (feat_tile.first.prefix != tt)
-                    continue;
-                if (!bits.tiles.count(feat_tile.first))
-                    continue;
-                auto &bit_tile = bits.tiles.at(feat_tile.first);
-                auto result = split_sites(&ctx, tt, bit_tile.set_bits, feat_tile.second);
-                for (auto &s : result) {
-                    sites.push_back(s);
-                    site_types.insert(s.site_type);
-                }
-            }
-        }
-        for (IdString st : site_types) {
+    const SiteSplitTable *site_split_table(IdString tile_type) {
+        const DeviceDatabase *db = device_db;
+        if (!db)
+            return nullptr;
+        auto found = db->site_splits.find(tile_type);
+        return (found != db->site_splits.end()) ? &found->second : nullptr;
+    }
+
+    void do_site_correlate(dict<IdString, SpecimenGroup> &tt_groups, std::ostream &out) {
+        std::vector<std::pair<IdString, SpecimenGroup*>> site_types;
+        for (auto &g : tt_groups)
+            site_types.emplace_back(g.first, &g.second);
+        std::sort(site_types.begin(), site_types.end(), [&](const auto &a, const auto &b) {
+            return a.first.str(&ctx) < b.first.str(&ctx);
+        });
+        for (auto [st, group_ptr] : site_types) {
             log_info("processing site type %s...\n", st.c_str(&ctx));
-            SpecimenGroup group;
-            group.tile_bits = 48*30; // TODO
-            for (auto &s : sites) {
-                if (s.site_type != st)
-                    continue;
-                group.specs.emplace_back(s.set_features, s.set_bits);
-            }
-            std::cout << "*** " << st.c_str(&ctx) << " ***" << std::endl;
+            auto &group = *group_ptr;
+            out << "*** " << st.c_str(&ctx) << " ***" << std::endl;
             group.find_deps();
-            group.solve(&ctx);
+            group.solve(&ctx, out);
         }
     }
 
     void run() {
+        threads = parse_thread_count(args.named.count("j") ? args.named.at("j").at(0) : "");
+        streaming = args.named.count("stream");
+        use_cache = args.named.count("cache");
+        if (args.named.count("filter"))
+            masks.add_builtin(&ctx, args.named.at("filter").at(0));
+        if (args.named.count("mask")) {
+            for (auto &mask_file : args.named.at("mask")) {
+                std::ifstream in(mask_file);
+                if (!in)
+                    log_error("failed to open mask file '%s'\n", mask_file.c_str());
+                std::string buf(std::istreambuf_iterator<char>(in), {});
+                masks.parse(&ctx, lines(buf));
+            }
+        }
+        parse_min_count();
+        bus_aware = args.named.count("bus");
+        std::ofstream convergence_file;
+        if (args.named.count("convergence")) {
+            convergence_file.open(args.named.at("convergence").at(0));
+            if (!convergence_file)
+                log_error("failed to open '%s' for writing\n", args.named.at("convergence").at(0).c_str());
+            convergence_file << "# specimens group features pending solved ambiguous empty changed" << std::endl;
+            convergence_out = &convergence_file;
+        }
+        if (args.named.count("tiles"))
+            tile_filter.parse(args.named.at("tiles").at(0));
+        if (args.named.count("shard")) {
+            auto [index, count] = split_view(args.named.at("shard").at(0), '/');
+            tile_filter.set_shard(parse_i32(index), parse_i32(count));
+        }
+        if (args.named.count("partial"))
+            streaming = true;
         find_files();
         parse_files();
-        filter_tiles();
-        if (args.named.count("filter"))
-            filter_bits(args.named.at("filter").at(0));
-        for (auto tt : included_tiletypes) {
-            if (args.named.count("sites"))
-                do_site_correlate(tt);
-            else
-                do_correlate(tt);
+        if (args.named.count("partial")) {
+            write_partials(args.named.at("partial").at(0));
+            return;
+        }
+        if (streaming) {
+            solve_accumulators();
+            return;
         }
+        // tile types are independent, so solve them in parallel and print the results in a deterministic order. The
+        // groups are resolved up front, as hashlib lookups can rehash and so the workers must not touch the dicts
+        struct TileTypeGroups {
+            IdString tile_type;
+            SpecimenGroup *group = nullptr;
+            dict<IdString, SpecimenGroup> *site_groups = nullptr;
+        };
+        std::vector<TileTypeGroups> sorted_tiletypes;
+        for (auto &g : groups)
+            sorted_tiletypes.push_back(TileTypeGroups{g.first, &g.second, nullptr});
+        for (auto &g : site_groups)
+            sorted_tiletypes.push_back(TileTypeGroups{g.first, nullptr, &g.second});
+        std::sort(sorted_tiletypes.begin(), sorted_tiletypes.end(), [&](const auto &a, const auto &b) {
+            return a.tile_type.str(&ctx) < b.tile_type.str(&ctx);
+        });
+        std::vector<std::string> results(sorted_tiletypes.size());
+        parallel_for(index_t(sorted_tiletypes.size()), threads, [&](index_t i) {
+            auto &tt = sorted_tiletypes.at(i);
+            std::ostringstream out;
+            if (tt.site_groups)
+                do_site_correlate(*tt.site_groups, out);
+            else
+                do_correlate(tt.tile_type, *tt.group, out);
+            results.at(i) = out.str();
+        });
+        write_results(results);
     }
 
     Context ctx;
-    pool<IdString> included_tiletypes;
+    int threads = 1;
+    bool streaming = false;
+    bool use_cache = false;
+    index_t min_count = 2;
+    bool bus_aware = false;
+    std::atomic<index_t> cache_hits{0};
+    std::ostream *convergence_out = nullptr;
+    index_t convergence_step = 1;
+    std::mutex convergence_mutex;
+    dict<AccumulatorKey, std::vector<BitVector>> last_results;
+    TileMasks masks;
+    std::atomic<const DeviceDatabase*> device_db{nullptr};
+    TileTypeFilter tile_filter;
+    dict<IdString, SpecimenGroup> groups;
+    dict<IdString, dict<IdString, SpecimenGroup>> site_groups; // tile type -> site type -> group
+    dict<AccumulatorKey, std::unique_ptr<SpecimenAccumulator>> accumulators;
+    std::mutex accumulator_mutex;
     std::vector<std::string> file_prefices;
-    std::vector<TileGrid> tile_bits;
-    std::vector<TileFeatures> tile_feats;
+    // loaded specimens waiting for the ones before them to be added to the groups
+    struct LoadedSpecimen {
+        TileGrid bits;
+        TileFeatures feats;
+    };
+    std::vector<std::unique_ptr<LoadedSpecimen>> pending;
+    index_t next_commit = 0, commit_window = 1;
+    bool committing = false;
+    std::mutex commit_mutex;
+    std::condition_variable commit_cv;
 };
 
 }
@@ -192,15 +505,29 @@ struct CorrelateWorker {
 int subcmd_correlate(int argc, const char *argv[]) {
     CmdlineParser parser;
     parser.add_opt("v", 0, "verbose output");
-    parser.add_opt("filter", 1, "filter mode");
-    parser.add_opt("tiles", 1, "comma separated list of tile types");
+    parser.add_opt("filter", 1, "built-in bit filter (EXCL_CMT_DRP)");
+    parser.add_opt("mask", 1, "file of per tile type bit masks to apply before correlating (may be given more than once)");
+    parser.add_opt("tiles", 1, "comma separated tile type rules: globs, 're:' regexes, '!' to exclude");
     parser.add_opt("sites", 0, "split tiles into sites (for IO only)");
-    parser.add_opt("min-count", 1, "minimum number of samples for a feature");
+    parser.add_opt("min-count", 1, "minimum number of samples for a feature to be solved (default: 2)");
+    parser.add_opt("bus", 0, "fill in indexed features (e.g. INIT[n]) from the bit stride of the rest of their bus");
+    parser.add_opt("j", 1, "number of worker threads (default: all cores)");
+    parser.add_opt("stream", 0, "fold specimens into running intersections as they load (bounded memory, no elimination of already explained bits)");
+    parser.add_opt("cache", 0, "keep decoded specimens in <name>.meowcache files and reuse them on later runs");
+    parser.add_opt("convergence", 1, "write a summary of solved and ambiguous features to a file as specimens are loaded");
+    parser.add_opt("db", 1, "also merge the results into this result database directory");
+    parser.add_opt("shard", 1, "i/n: only correlate tile types whose name hashes to shard i of n");
+    parser.add_opt("specimens", 1, "a-b, a- or a: only load specimens a to b (inclusive), a onwards, or just "
+            "a, of the sorted specimen list");
+    parser.add_opt("partial", 1, "write accumulators to a file for mergeacc instead of solving; implies -stream, so "
+            "the merged result has no elimination of already explained bits");
     parser.add_positional("folder", false, "specimen folder");
 
     CmdlineResult result;
     if (!parser.parse(argc, argv, 2, std::cerr, result))
         return 1;
+    if (result.named.count("v"))
+        verbose_flag = true;
 
     CorrelateWorker worker(result);
     worker.run();
@@ -208,4 +535,26 @@ int subcmd_correlate(int argc, const char *argv[]) {
     return 0;
 }
 
+int subcmd_mergeacc(int argc, const char *argv[]) {
+    CmdlineParser parser;
+    parser.add_opt("v", 0, "verbose output");
+    parser.add_opt("min-count", 1, "minimum number of samples for a feature to be solved (default: 2)");
+    parser.add_opt("bus", 0, "fill in indexed features (e.g. INIT[n]) from the bit stride of the rest of their bus");
+    parser.add_opt("j", 1, "number of worker threads (default: all cores)");
+    parser.add_opt("db", 1, "also merge the results into this result database directory");
+    parser.add_opt("partial", 1, "write the merged accumulators to a file instead of solving");
+    parser.add_positional_list("partials", "partial result files from correlate -partial");
+
+    CmdlineResult result;
+    if (!parser.parse(argc, argv, 2, std::cerr, result))
+        return 1;
+    if (result.named.count("v"))
+        verbose_flag = true;
+
+    CorrelateWorker worker(result);
+    worker.run_merge();
+
+    return 0;
+}
+
 MEOW_NAMESPACE_END
@@ -0,0 +1,57 @@
+#include "tools.h"
+#include "bitstream.h"
+#include "tile.h"
+#include "context.h"
+#include "cmdline.h"
+#include "log.h"
+#include "database.h"
+#include "segbits.h"
+#include "decoder.h"
+
+#include <fstream>
+
+MEOW_NAMESPACE_BEGIN
+
+int subcmd_decode(int argc, const char *argv[]) {
+    CmdlineParser parser;
+    parser.add_opt("v", 0, "verbose output");
+    parser.add_opt("db", 1, "correlate results or result database directory to decode with (may be given more than once)");
+    parser.add_positional("bitstream", false, "input bitstream file");
+    parser.add_positional("result", true, "output features file");
+    CmdlineResult result;
+    if (!parser.parse(argc, argv, 2, std::cerr, result))
+        return 1;
+    if (result.named.count("v"))
+        verbose_flag = true;
+    if (!result.named.count("db"))
+        log_error("no -db given\n");
+
+    Context ctx;
+    SegBits segbits;
+    for (auto &db_path : result.named.at("db"))
+        segbits.load(&ctx, db_path);
+
+    std::ifstream in(result.positional.at(0), std::ios::binary);
+    if (!in)
+        log_error("failed to open bitstream '%s'\n", result.positional.at(0).c_str());
+    auto bit = RawBitstream::read(in);
+    auto frames = packets_to_frames(&ctx, bit.packetise());
+    auto grid = frames_to_tiles(&ctx, frames);
+
+    FeatureDecoder decoder;
+    decoder.compile(&ctx, segbits, get_device_db(&ctx, *frames.dev));
+    auto features = decoder.decode(grid);
+
+    std::ofstream *out_file = nullptr;
+    if (int(result.positional.size()) >= 2)
+        out_file = new std::ofstream(result.positional.at(1));
+    auto &out_stream = out_file ? *out_file : std::cout;
+    features.write(&ctx, out_stream);
+    if (out_file) {
+        out_file->close();
+        delete out_file;
+    }
+    return 0;
+}
+
+MEOW_NAMESPACE_END
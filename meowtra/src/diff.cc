@@ -0,0 +1,150 @@
+#include "tools.h"
+#include "bitstream.h"
+#include "tile.h"
+#include "context.h"
+#include "cmdline.h"
+#include "log.h"
+#include "database.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <fstream>
+
+MEOW_NAMESPACE_BEGIN
+
+namespace {
+
+const int frame_length = 93; // TODO: other devices than xcup
+
+struct BitDiff {
+    index_t bit;
+    bool added; // set in the second bitstream but not the first
+};
+
+// word i of a frame of data_len words; missing frames and words past the end read as zero
+inline uint32_t frame_word(const uint32_t *data, index_t data_len, index_t i) {
+    return (data && i < data_len) ? data[i] : 0U;
+}
+
+uint64_t hash_frame(const uint32_t *data, index_t data_len, index_t len) {
+    // FNV-1a over words; null frames hash to the same value as all-zero frames
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (index_t i = 0; i < len; i++)
+        h = (h ^ frame_word(data, data_len, i)) * 0x100000001b3ULL;
+    return h;
+}
+
+bool frames_equal(const uint32_t *a, index_t len_a, const uint32_t *b, index_t len_b, index_t len) {
+    if (a && b && len_a == len_b && len_a == len)
+        return std::equal(a, a + len, b);
+    for (index_t i = 0; i < len; i++)
+        if (frame_word(a, len_a, i) != frame_word(b, len_b, i))
+            return false;
+    return true;
+}
+
+}
+
+int subcmd_diff(int argc, const char *argv[]) {
+    CmdlineParser parser;
+    parser.add_opt("v", 0, "verbose output");
+    parser.add_positional("first", false, "first bitstream file");
+    parser.add_positional("second", false, "second bitstream file");
+    parser.add_positional("result", true, "output results file");
+    CmdlineResult result;
+    if (!parser.parse(argc, argv, 2, std::cerr, result))
+        return 1;
+    if (result.named.count("v"))
+        verbose_flag = true;
+
+    Context ctx;
+    // both bitstreams keep their backing words alive for the frame chunks
+    std::ifstream in_a(result.positional.at(0), std::ios::binary), in_b(result.positional.at(1), std::ios::binary);
+    if (!in_a || !in_b)
+        log_error("failed to open input bitstreams\n");
+    auto bit_a = RawBitstream::read(in_a), bit_b = RawBitstream::read(in_b);
+    auto frames_a = packets_to_frames(&ctx, bit_a.packetise());
+    auto frames_b = packets_to_frames(&ctx, bit_b.packetise());
+    if (!frames_a.dev || frames_a.dev != frames_b.dev)
+        log_error("bitstreams are for different devices\n");
+    const auto &db = get_device_db(&ctx, *frames_a.dev);
+
+    std::vector<FrameKey> frame_keys;
+    for (auto &f : frames_a.frame_data)
+        frame_keys.push_back(f.first);
+    for (auto &f : frames_b.frame_data)
+        if (!frames_a.frame_data.count(f.first))
+            frame_keys.push_back(f.first);
+
+    dict<TileKey, std::vector<BitDiff>> tile_diffs;
+    index_t identical = 0, differing = 0, diff_bits = 0, unmapped_bits = 0;
+    std::array<uint32_t, frame_length> delta;
+    for (auto key : frame_keys) {
+        auto found_a = frames_a.frame_data.find(key), found_b = frames_b.frame_data.find(key);
+        const uint32_t *a = (found_a != frames_a.frame_data.end()) ? found_a->second.ptr() : nullptr;
+        const uint32_t *b = (found_b != frames_b.frame_data.end()) ? found_b->second.ptr() : nullptr;
+        index_t len_a = a ? found_a->second.size() : 0;
+        index_t len_b = b ? found_b->second.size() : 0;
+        if (a && b && len_a != len_b)
+            log_warning("frame %d.%08x has different lengths %d and %d\n", int(key.slr), key.frame, len_a, len_b);
+        // a frame missing from one side compares as zeros of the other's length
+        index_t len = std::min<index_t>(frame_length, std::max(len_a, len_b));
+        // the hash is only a quick reject; equal hashes are confirmed word by word
+        if (hash_frame(a, len_a, len) == hash_frame(b, len_b, len) && frames_equal(a, len_a, b, len_b, len)) {
+            ++identical;
+            continue;
+        }
+        ++differing;
+        // plain loop over words so the compiler can vectorise it
+        for (index_t i = 0; i < len; i++)
+            delta[i] = frame_word(a, len_a, i) ^ frame_word(b, len_b, i);
+        for (index_t i = 0; i < len; i++) {
+            uint32_t word = delta[i];
+            while (word != 0) {
+                index_t frame_bit = i * 32 + std::countr_zero(word);
+                word &= word - 1;
+                ++diff_bits;
+                TileBitLocation loc;
+                if (!db.bit_index.lookup(db.tile_regions, key.slr, key.frame, frame_bit, loc)) {
+                    log_verbose("unmapped bit %d.%08x bit %d\n", int(key.slr), key.frame, frame_bit);
+                    ++unmapped_bits;
+                    continue;
+                }
+                bool added = (frame_word(b, len_b, i) >> (frame_bit % 32)) & 0x1;
+                tile_diffs[db.tile_regions.at(loc.region).tile_key(loc.tile)].push_back(BitDiff{loc.bit, added});
+            }
+        }
+    }
+    log_info("%d frames identical, %d frames differ in %d bits (%d outside any tile)\n",
+        identical, differing, diff_bits, unmapped_bits);
+
+    std::ofstream *out_file = nullptr;
+    if (int(result.positional.size()) >= 3)
+        out_file = new std::ofstream(result.positional.at(2));
+    auto &out = out_file ? *out_file : std::cout;
+
+    std::vector<std::pair<std::string, TileKey>> sorted_tiles;
+    for (auto &t : tile_diffs)
+        sorted_tiles.emplace_back(t.first.str(&ctx), t.first);
+    std::sort(sorted_tiles.begin(), sorted_tiles.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    dict<IdString, index_t> tile_type_bits;
+    for (auto &r : db.tile_regions)
+        tile_type_bits[r.prefix] = r.tile_height * 48;
+    for (auto &[name, key] : sorted_tiles) {
+        auto &diffs = tile_diffs.at(key);
+        std::sort(diffs.begin(), diffs.end(), [](const BitDiff &a, const BitDiff &b) { return a.bit < b.bit; });
+        index_t bits = tile_type_bits.at(key.prefix);
+        out << ".tile " << name << std::endl;
+        for (auto &d : diffs)
+            out << (d.added ? '+' : '-') << (d.bit / bits) << "_" << (d.bit % bits) << std::endl;
+    }
+
+    if (out_file) {
+        out_file->close();
+        delete out_file;
+    }
+    return 0;
+}
+
+MEOW_NAMESPACE_END
@@ -9,7 +9,7 @@ USING_MEOW_NAMESPACE;
 int main(int argc, char *argv[]) {
     auto top_help = [&]() {
         std::cerr << "Usage: ";
-        std::cerr << argv[0] << " <unpack|pack|correlate|fuzztools> <options>" << std::endl;
+        std::cerr << argv[0] << " <unpack|pack|correlate|mergedb|mergeacc|diff|decode|fuzztools> <options>" << std::endl;
     };
     if (argc < 2) {
         top_help();
@@ -20,6 +20,14 @@ int main(int argc, char *argv[]) {
         return subcmd_unpack(argc, (const char**)argv);
     } else if (subcommand == "correlate") {
         return subcmd_correlate(argc, (const char**)argv);
+    } else if (subcommand == "mergedb") {
+        return subcmd_mergedb(argc, (const char**)argv);
+    } else if (subcommand == "mergeacc") {
+        return subcmd_mergeacc(argc, (const char**)argv);
+    } else if (subcommand == "diff") {
+        return subcmd_diff(argc, (const char**)argv);
+    } else if (subcommand == "decode") {
+        return subcmd_decode(argc, (const char**)argv);
     } else if (subcommand == "fuzztools") {
         return subcmd_fuzztools(argc, (const char**)argv);
     } else if (subcommand == "pack") {
@@ -0,0 +1,37 @@
+#include "tools.h"
+#include "context.h"
+#include "cmdline.h"
+#include "log.h"
+#include "segbits.h"
+
+#include <filesystem>
+
+MEOW_NAMESPACE_BEGIN
+
+int subcmd_mergedb(int argc, const char *argv[]) {
+    CmdlineParser parser;
+    parser.add_opt("v", 0, "verbose output");
+    parser.add_positional("db", false, "result database directory to merge into (created if needed)");
+    parser.add_positional_list("inputs", "correlate output files or result database directories");
+    CmdlineResult result;
+    if (!parser.parse(argc, argv, 2, std::cerr, result))
+        return 1;
+    if (result.named.count("v"))
+        verbose_flag = true;
+
+    Context ctx;
+    SegBits segbits;
+    const std::string &db_dir = result.positional.at(0);
+    if (std::filesystem::is_directory(db_dir))
+        segbits.read_db(&ctx, db_dir);
+    for (index_t i = 1; i < index_t(result.positional.size()); i++)
+        segbits.load(&ctx, result.positional.at(i));
+    segbits.write_db(&ctx, db_dir);
+    index_t entries = 0;
+    for (auto &tt : segbits.tile_types)
+        entries += index_t(tt.second.size());
+    log_info("wrote %d features of %d tile types to '%s'\n", entries, int(segbits.tile_types.size()), db_dir.c_str());
+    return 0;
+}
+
+MEOW_NAMESPACE_END
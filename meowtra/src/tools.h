@@ -9,6 +9,10 @@ int subcmd_unpack(int argc, const char *argv[]);
 // int subcmd_pack(int argc, const char *argv[]);
 // ...
 int subcmd_correlate(int argc, const char *argv[]);
+int subcmd_mergedb(int argc, const char *argv[]);
+int subcmd_mergeacc(int argc, const char *argv[]);
+int subcmd_diff(int argc, const char *argv[]);
+int subcmd_decode(int argc, const char *argv[]);
 int subcmd_fuzztools(int argc, const char *argv[]);
 
 MEOW_NAMESPACE_END
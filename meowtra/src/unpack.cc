@@ -5,9 +5,10 @@
 #include "cmdline.h"
 #include "log.h"
 #include "database.h"
-#include "constids.h"
+#include "parallel.h"
 
 #include <fstream>
+#include <filesystem>
 
 MEOW_NAMESPACE_BEGIN
 
@@ -19,55 +20,110 @@ void dump_frame_addrs(const std::vector<BitstreamPacket> &packets, std::ostream
         out << stringf("%d %08x\n", int(packet.slr), packet.payload.get(0));
     }
 }
-void dump_tile_bits(Context *ctx, TileGrid grid, std::ostream &out, bool skip_default_logic = true) {
-    // 0_8, 0_16, 0_24, 0_32, 0_40; 4_0, 4_8, 4_16, 4_24, 4_32, 4_40, 8_0, 8_8, 8_32, 8_40
-    static const pool<index_t> empty_logic_tile = {0, 8, 16, 24, 32, 40, 192, 200, 208, 216, 224, 232, 384, 392, 416, 424};
-
+void dump_tile_bits(Context *ctx, const TileGrid &grid, std::ostream &out) {
+    // default (unconfigured) tiles are already dropped by frames_to_tiles
     for (auto &t : grid.tiles) {
-        if (t.second.set_bits.empty())
+        if (t.second.set_bits.none())
             continue;
-        if (skip_default_logic && t.first.prefix.in(id_CLEL_L, id_CLEL_R, id_CLEM, id_CLEM_R)) {
-            if (t.second.set_bits == empty_logic_tile)
-                continue;
-        }
         out << ".tile " << t.first.str(ctx) << std::endl;
         for (index_t b : t.second.set_bits)
             out << stringf("%d_%d\n", b / t.second.bits, b % t.second.bits);
     }
 }
+
+void unpack_file(Context *ctx, const std::string &filename, std::ostream &out, bool frame_addrs) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        log_error("failed to open bitstream '%s'\n", filename.c_str());
+    auto bit = RawBitstream::read(in);
+    auto packets = bit.packetise();
+    if (frame_addrs) {
+        dump_frame_addrs(packets, out);
+    } else {
+        auto frames = packets_to_frames(ctx, packets);
+        log_verbose("%s: device %s\n", filename.c_str(), frames.dev->name.c_str());
+        auto grid = frames_to_tiles(ctx, frames);
+        dump_tile_bits(ctx, grid, out);
+    }
+}
+
+// Batch mode: decode every input (or every .bit file in an input directory) into out_dir, sharing one Context
+int unpack_batch(const CmdlineResult &args) {
+    std::filesystem::path out_dir(args.named.at("out").at(0));
+    std::error_code ec;
+    std::filesystem::create_directories(out_dir, ec);
+    if (ec)
+        log_error("failed to create output directory '%s': %s\n", out_dir.string().c_str(), ec.message().c_str());
+    std::vector<std::filesystem::path> inputs;
+    for (auto &pos : args.positional) {
+        std::filesystem::path path(pos);
+        if (std::filesystem::is_directory(path)) {
+            for (auto entry : std::filesystem::directory_iterator(path)) {
+                if (entry.path().extension() == ".bit")
+                    inputs.push_back(entry.path());
+            }
+        } else {
+            inputs.push_back(path);
+        }
+    }
+    if (inputs.empty())
+        log_error("no input bitstreams given\n");
+    // outputs are named by stem, so the same name in two input directories would silently overwrite
+    dict<std::string, std::string> out_names;
+    for (auto &input : inputs) {
+        auto name = input.stem().string() + ".txt";
+        auto found = out_names.find(name);
+        if (found != out_names.end())
+            log_error("inputs '%s' and '%s' would both be unpacked to '%s'\n", found->second.c_str(),
+                    input.string().c_str(), name.c_str());
+        out_names[name] = input.string();
+    }
+    int threads = parse_thread_count(args.named.count("j") ? args.named.at("j").at(0) : "");
+    bool frame_addrs = args.named.count("frame-addrs");
+    log_info("unpacking %d bitstreams using %d threads...\n", int(inputs.size()), threads);
+    Context ctx;
+    parallel_for(index_t(inputs.size()), threads, [&](index_t i) {
+        auto &input = inputs.at(i);
+        auto out_path = out_dir / (input.stem().string() + ".txt");
+        std::ofstream out(out_path);
+        if (!out)
+            log_error("failed to open '%s' for writing\n", out_path.string().c_str());
+        unpack_file(&ctx, input.string(), out, frame_addrs);
+        out.close();
+        if (!out)
+            log_error("failed to write '%s'\n", out_path.string().c_str());
+    });
+    return 0;
+}
 }
 
 int subcmd_unpack(int argc, const char *argv[]) {
     CmdlineParser parser;
     parser.add_opt("v", 0, "verbose output");
     parser.add_opt("frame-addrs", 0, "dump frame addresses only (for bootstrapping)");
+    parser.add_opt("out", 1, "batch mode: unpack all inputs into this directory as <name>.txt");
+    parser.add_opt("j", 1, "number of threads for batch mode (default: all cores)");
 
-    parser.add_positional("bitstream", false, "input bitstream file");
-    parser.add_positional("result", true, "output results file");
+    parser.add_positional_list("inputs", "input bitstream and optional output results file; with -out, any number of "
+            "input bitstreams or directories of .bit files");
     CmdlineResult result;
     if (!parser.parse(argc, argv, 2, std::cerr, result))
         return 1;
     if (result.named.count("v"))
         verbose_flag = true;
-    std::ifstream in(result.positional.at(0), std::ios::binary);
+    if (result.named.count("out"))
+        return unpack_batch(result);
+    if (result.positional.empty() || int(result.positional.size()) > 2)
+        log_error("expected an input bitstream and optional output file (use -out for multiple inputs)\n");
+
     std::ofstream *out_file = nullptr;
     if (int(result.positional.size()) >= 2)
         out_file = new std::ofstream(result.positional.at(1));
     auto &out_stream = out_file ? *out_file : std::cout;
 
-    auto bit = RawBitstream::read(in);
-    {
-        auto packets = bit.packetise();
-        if (result.named.count("frame-addrs")) {
-            dump_frame_addrs(packets, out_stream);
-        } else {
-            auto frames = packets_to_frames(packets);
-            log_info("device: %s\n", frames.dev->name.c_str());
-            Context ctx;
-            auto grid = frames_to_tiles(&ctx, frames);
-            dump_tile_bits(&ctx, grid, out_stream);
-        }
-    }
+    Context ctx;
+    unpack_file(&ctx, result.positional.at(0), out_stream, result.named.count("frame-addrs"));
+
     if (out_file) {
         out_file->close();
         delete out_file;